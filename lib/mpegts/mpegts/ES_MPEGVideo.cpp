@@ -8,6 +8,7 @@
 
 #include "ES_MPEGVideo.h"
 #include "bitstream.h"
+#include "byteScanner.h"
 #include "debug.h"
 
 using namespace TSDemux;
@@ -80,6 +81,18 @@ void ES_MPEG2Video::Parse(STREAM_PKT *pkt)
         break;
       }
     }
+    // No start code can end in the next bytes unless the register holds its first bytes,
+    // jump directly to the next start code found in the buffer
+    if ((startcode & 0xff) != 0 && (startcode & 0xffffff) != 0x000001)
+    {
+      int next = p + static_cast<int>(FindStartCode(es_buf + p, l));
+      if (next > p)
+      {
+        p = next < static_cast<int>(es_len) - 3 ? next : static_cast<int>(es_len) - 3;
+        startcode = 0xffffffff;
+        continue;
+      }
+    }
     startcode = startcode << 8 | es_buf[p++];
   }
   es_parsed = p;
@@ -8,6 +8,7 @@
 
 #include "ES_h264.h"
 #include "bitstream.h"
+#include "byteScanner.h"
 #include "debug.h"
 
 #include <cstring>      // for memset memcpy
@@ -120,6 +121,18 @@ void ES_h264::Parse(STREAM_PKT* pkt)
         break;
       }
     }
+    // No start code can end in the next bytes unless the register holds its first bytes,
+    // jump directly to the next start code found in the buffer
+    if ((startcode & 0xff) != 0 && (startcode & 0xffffff) != 0x000001)
+    {
+      size_t next = p + FindStartCode(es_buf + p, es_len - p);
+      if (next > p)
+      {
+        p = next < es_len - 3 ? next : es_len - 3;
+        startcode = 0xffffffff;
+        continue;
+      }
+    }
     startcode = (startcode << 8) | es_buf[p++];
   }
   es_parsed = p;
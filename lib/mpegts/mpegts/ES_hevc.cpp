@@ -8,6 +8,7 @@
 
 #include "ES_hevc.h"
 #include "bitstream.h"
+#include "byteScanner.h"
 #include "debug.h"
 
 #include <cstring>      // for memset memcpy
@@ -48,6 +49,20 @@ void ES_hevc::Parse(STREAM_PKT* pkt)
 
   while (p < es_len)
   {
+    // No start code can end in the next bytes unless the register holds its first bytes,
+    // jump to the next start code found, the last 2 bytes are kept for a split start code
+    if ((startcode & 0xff) != 0)
+    {
+      size_t next = p + FindStartCode(es_buf + p, es_len - p);
+      if (next > es_len - 2)
+        next = es_len - 2;
+      if (next > p)
+      {
+        p = next;
+        startcode = 0xffffffff;
+        continue;
+      }
+    }
     startcode = startcode << 8 | es_buf[p++];
     if ((startcode & 0x00ffffff) == 0x00000001)
     {
@@ -0,0 +1,154 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "byteScanner.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BYTESCANNER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BYTESCANNER_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace TSDemux;
+
+namespace
+{
+#if defined(BYTESCANNER_SSE2) || defined(BYTESCANNER_NEON)
+  inline unsigned int count_trailing_zeros(uint64_t mask)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+#if defined(_M_X64) || defined(_M_ARM64)
+    _BitScanForward64(&index, mask);
+#else
+    if (!_BitScanForward(&index, static_cast<unsigned long>(mask)))
+    {
+      _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+      index += 32;
+    }
+#endif
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctzll(mask));
+#endif
+  }
+#endif
+}
+
+size_t TSDemux::FindByte(const uint8_t* data, size_t size, uint8_t value)
+{
+  size_t i = 0;
+
+#if defined(BYTESCANNER_SSE2)
+  const __m128i pattern = _mm_set1_epi8(static_cast<char>(value));
+  for (; i + 16 <= size; i += 16)
+  {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern));
+    if (mask)
+      return i + count_trailing_zeros(static_cast<uint64_t>(mask));
+  }
+#elif defined(BYTESCANNER_NEON)
+  const uint8x16_t pattern = vdupq_n_u8(value);
+  for (; i + 16 <= size; i += 16)
+  {
+    const uint8x16_t eq = vceqq_u8(vld1q_u8(data + i), pattern);
+    // Narrow each byte of the comparison to 4 bits, to get a 64 bits mask
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    if (mask)
+      return i + (count_trailing_zeros(mask) >> 2);
+  }
+#endif
+
+  for (; i < size; ++i)
+  {
+    if (data[i] == value)
+      return i;
+  }
+  return size;
+}
+
+size_t TSDemux::FindPacketSync(const uint8_t* data, size_t size, size_t packet_size, size_t sync_count)
+{
+  if (!sync_count)
+    return size;
+
+  const size_t span = (sync_count - 1) * packet_size;
+  if (span >= size)
+    return size;
+
+  // Last offset where all the sync bytes of a candidate are inside the buffer
+  const size_t last = size - span;
+  size_t offset = 0;
+
+  while (offset < last)
+  {
+    offset += FindByte(data + offset, last - offset, TS_SYNC_BYTE);
+    if (offset >= last)
+      break;
+
+    size_t count = 1;
+    while (count < sync_count && data[offset + count * packet_size] == TS_SYNC_BYTE)
+      ++count;
+
+    if (count == sync_count)
+      return offset;
+
+    ++offset;
+  }
+  return size;
+}
+
+size_t TSDemux::FindStartCode(const uint8_t* data, size_t size)
+{
+  size_t i = 0;
+
+  // Compare 16 candidates at time, each lane checks its 3 bytes from shifted loads
+#if defined(BYTESCANNER_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  for (; i + 18 <= size; i += 16)
+  {
+    const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+    const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+    const __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                        _mm_cmpeq_epi8(b2, one));
+    const int mask = _mm_movemask_epi8(match);
+    if (mask)
+      return i + count_trailing_zeros(static_cast<uint64_t>(mask));
+  }
+#elif defined(BYTESCANNER_NEON)
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t one = vdupq_n_u8(1);
+  for (; i + 18 <= size; i += 16)
+  {
+    const uint8x16_t match = vandq_u8(vandq_u8(vceqq_u8(vld1q_u8(data + i), zero),
+                                               vceqq_u8(vld1q_u8(data + i + 1), zero)),
+                                      vceqq_u8(vld1q_u8(data + i + 2), one));
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(match), 4);
+    const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+    if (mask)
+      return i + (count_trailing_zeros(mask) >> 2);
+  }
+#endif
+
+  for (; i + 3 <= size; ++i)
+  {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+      return i;
+  }
+  return size;
+}
@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#ifndef BYTESCANNER_H
+#define BYTESCANNER_H
+
+#include <inttypes.h>
+#include <cstddef>    // for size_t
+
+#define TS_SYNC_BYTE            0x47
+
+namespace TSDemux
+{
+  /*
+   * Find the first occurrence of a byte value in a buffer.
+   * The buffer is scanned 16 bytes at time with SSE2 or NEON when available,
+   * otherwise byte by byte.
+   *
+   * returns the offset of the byte found, or size when not found
+   */
+  size_t FindByte(const uint8_t* data, size_t size, uint8_t value);
+
+  /*
+   * Find the first TS sync byte that is followed by other sync bytes
+   * at each packet size stride, so a sync byte value contained in a
+   * payload is not taken as a packet start.
+   * Only the candidates having all the sync_count sync bytes inside the
+   * buffer are checked.
+   *
+   * returns the offset of the first packet, or size when not found
+   */
+  size_t FindPacketSync(const uint8_t* data, size_t size, size_t packet_size, size_t sync_count);
+
+  /*
+   * Find the first Annex-B start code prefix (00 00 01) in a buffer.
+   * Only the start codes having all the 3 bytes inside the buffer are
+   * found, a prefix split at the buffer end is left to the caller.
+   *
+   * returns the offset of the first prefix byte, or size when not found
+   */
+  size_t FindStartCode(const uint8_t* data, size_t size);
+}
+
+#endif /* BYTESCANNER_H */
@@ -13,6 +13,7 @@
 #include <cstring>    // memset memcpy memmove
 #include <climits>    // for INT_MAX
 #include <cerrno>
+#include <cinttypes>  // for PRIu64
 
 using namespace TSDemux;
 
@@ -34,6 +35,9 @@ ElementaryStream::ElementaryStream(uint16_t pes_pid)
   , es_found_frame(false)
   , es_frame_valid(false)
   , es_extraDataChanged(false)
+  , es_alloc_count(0)
+  , es_move_count(0)
+  , es_move_bytes(0)
 {
   memset(&stream_info, 0, sizeof(STREAM_INFO));
 }
@@ -43,6 +47,8 @@ ElementaryStream::~ElementaryStream(void)
   if (es_buf)
   {
     DBG(DEMUX_DBG_DEBUG, "free stream buffer %.4x: allocated size was %zu\n", pid, es_alloc);
+    DBG(DEMUX_DBG_DEBUG, "stream buffer %.4x: %zu allocations, %zu moves of %" PRIu64 " bytes\n",
+        pid, es_alloc_count, es_move_count, es_move_bytes);
     free(es_buf);
     es_buf = NULL;
   }
@@ -66,45 +72,65 @@ int ElementaryStream::Append(const unsigned char* buf, size_t len, bool new_pts)
   if (new_pts)
     es_pts_pointer = es_len;
 
-  if (es_buf && es_consumed)
-  {
-    if (es_consumed < es_len)
-    {
-      memmove(es_buf, es_buf + es_consumed, es_len - es_consumed);
-      es_len -= es_consumed;
-      es_parsed -= es_consumed;
-      if (es_pts_pointer > es_consumed)
-        es_pts_pointer -= es_consumed;
-      else
-        es_pts_pointer = 0;
+  // All the payload has been consumed, restart from the buffer front without any move
+  if (es_consumed && es_consumed >= es_len)
+    ClearBuffer();
 
-      es_consumed = 0;
-    }
-    else
-      ClearBuffer();
-  }
+  // The consumed payload is kept in place until there is no room left at the
+  // buffer end, so the parsers keep a contiguous view without a move on each append
   if (es_len + len > es_alloc)
   {
-    if (es_alloc >= ES_MAX_BUFFER_SIZE)
-      return -ENOMEM;
-
-    size_t n = (es_alloc ? (es_alloc + len) * 2 : es_alloc_init);
-    if (n > ES_MAX_BUFFER_SIZE)
-      n = ES_MAX_BUFFER_SIZE;
+    size_t pending = es_len - es_consumed;
 
-    DBG(DEMUX_DBG_DEBUG, "realloc buffer size to %zu for stream %.4x\n", n, pid);
-    unsigned char* p = es_buf;
-    es_buf = (unsigned char*)realloc(es_buf, n * sizeof(*es_buf));
-    if (es_buf)
+    // Move the pending payload to the front only when this frees at least as much
+    // room as the size moved, so the cost of the moves is amortized over the appends
+    if (es_consumed && pending + len <= es_alloc &&
+        (es_consumed >= pending || es_alloc >= ES_MAX_BUFFER_SIZE))
     {
-      es_alloc = n;
+      MoveBuffer(es_buf);
     }
     else
     {
-      free(p);
-      es_alloc = 0;
-      es_len = 0;
-      return -ENOMEM;
+      if (es_alloc >= ES_MAX_BUFFER_SIZE)
+        return -ENOMEM;
+
+      size_t n = (es_alloc ? (es_alloc + len) * 2 : es_alloc_init);
+      // A first payload bigger than the initial size must fit too
+      if (n < pending + len)
+        n = pending + len;
+      if (n > ES_MAX_BUFFER_SIZE)
+        n = ES_MAX_BUFFER_SIZE;
+      if (n < pending + len)
+        return -ENOMEM;
+
+      DBG(DEMUX_DBG_DEBUG, "realloc buffer size to %zu for stream %.4x\n", n, pid);
+      unsigned char* p = es_buf;
+      if (es_consumed)
+      {
+        // Only the pending payload is copied to the new buffer
+        unsigned char* buffer = (unsigned char*)malloc(n * sizeof(*es_buf));
+        if (buffer)
+        {
+          MoveBuffer(buffer);
+          free(p);
+        }
+        es_buf = buffer;
+      }
+      else
+        es_buf = (unsigned char*)realloc(es_buf, n * sizeof(*es_buf));
+
+      if (es_buf)
+      {
+        es_alloc = n;
+        es_alloc_count++;
+      }
+      else
+      {
+        free(p);
+        es_alloc = 0;
+        ClearBuffer();
+        return -ENOMEM;
+      }
     }
   }
 
@@ -117,6 +143,26 @@ int ElementaryStream::Append(const unsigned char* buf, size_t len, bool new_pts)
   return 0;
 }
 
+void ElementaryStream::MoveBuffer(unsigned char* dest)
+{
+  size_t pending = es_len - es_consumed;
+  if (pending)
+  {
+    memmove(dest, es_buf + es_consumed, pending);
+    es_move_count++;
+    es_move_bytes += pending;
+  }
+
+  es_len = pending;
+  es_parsed = es_parsed > es_consumed ? es_parsed - es_consumed : 0;
+  if (es_pts_pointer > es_consumed)
+    es_pts_pointer -= es_consumed;
+  else
+    es_pts_pointer = 0;
+
+  es_consumed = 0;
+}
+
 const char* ElementaryStream::GetStreamCodecName(STREAM_TYPE stream_type)
 {
   switch (stream_type)
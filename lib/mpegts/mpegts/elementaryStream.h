@@ -102,22 +102,32 @@ namespace TSDemux
     bool GetStreamPacket(STREAM_PKT* pkt);
     virtual void Parse(STREAM_PKT* pkt);
 
+    /* Buffer stats: the allocations and the moves of the pending payload done by Append */
+    size_t GetAllocCount() const { return es_alloc_count; }
+    size_t GetMoveCount() const { return es_move_count; }
+    uint64_t GetMoveBytes() const { return es_move_bytes; }
+
   protected:
     void ResetStreamPacket(STREAM_PKT* pkt);
     uint64_t Rescale(uint64_t a, uint64_t b, uint64_t c);
     bool SetVideoInformation(int FpsScale, int FpsRate, int Height, int Width, float Aspect, bool Interlaced);
     bool SetAudioInformation(int Channels, int SampleRate, int BitRate, int BitsPerSample, int BlockAlign, int codecProfile = 0);
+    void MoveBuffer(unsigned char* dest);
 
     size_t es_alloc_init;         ///< Initial allocation of memory for buffer
     unsigned char* es_buf;        ///< The Pointer to buffer
     size_t es_alloc;              ///< Allocated size of memory for buffer
     size_t es_len;                ///< Size of data in buffer
-    size_t es_consumed;           ///< Consumed payload. Will be erased on next append
+    size_t es_consumed;           ///< Consumed payload. Erased on append when there is no room left
     size_t es_pts_pointer;        ///< Position in buffer where current PTS becomes applicable
     size_t es_parsed;             ///< Parser: Last processed position in buffer
     bool   es_found_frame;        ///< Parser: Found frame
     bool   es_frame_valid;
     bool   es_extraDataChanged;
+
+    size_t es_alloc_count;        ///< Stats: Number of buffer allocations
+    size_t es_move_count;         ///< Stats: Number of pending payload moves
+    uint64_t es_move_bytes;       ///< Stats: Total size of pending payload moved
   };
 }
 
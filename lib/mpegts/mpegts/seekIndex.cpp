@@ -0,0 +1,199 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "seekIndex.h"
+#include "byteScanner.h"
+#include "tsDemuxer.h"
+
+#include <cstring>    // for memcpy
+
+using namespace TSDemux;
+
+namespace
+{
+  enum START_CODE_TYPE
+  {
+    START_CODE_OTHER,           // Unit before the picture data e.g. AUD, SEI, PPS
+    START_CODE_RANDOM_ACCESS,   // Unit that begins a random access point
+    START_CODE_PICTURE          // Picture data that is not a random access point
+  };
+
+  bool has_start_codes(STREAM_TYPE type)
+  {
+    return type == STREAM_TYPE_VIDEO_H264 || type == STREAM_TYPE_VIDEO_HEVC ||
+           type == STREAM_TYPE_VIDEO_MPEG1 || type == STREAM_TYPE_VIDEO_MPEG2;
+  }
+
+  START_CODE_TYPE get_start_code_type(STREAM_TYPE type, uint8_t header)
+  {
+    switch (type)
+    {
+      case STREAM_TYPE_VIDEO_H264:
+      {
+        const uint8_t nal_type = header & 0x1f;
+        // IDR slice or SPS
+        if (nal_type == 5 || nal_type == 7)
+          return START_CODE_RANDOM_ACCESS;
+        // Non IDR slices
+        if (nal_type >= 1 && nal_type <= 4)
+          return START_CODE_PICTURE;
+        return START_CODE_OTHER;
+      }
+      case STREAM_TYPE_VIDEO_HEVC:
+      {
+        const uint8_t nal_type = (header >> 1) & 0x3f;
+        // IRAP slice (BLA, IDR, CRA), VPS or SPS
+        if ((nal_type >= 16 && nal_type <= 21) || nal_type == 32 || nal_type == 33)
+          return START_CODE_RANDOM_ACCESS;
+        // Other VCL units
+        if (nal_type < 32)
+          return START_CODE_PICTURE;
+        return START_CODE_OTHER;
+      }
+      default:
+        // Sequence header or GOP header
+        if (header == 0xb3 || header == 0xb8)
+          return START_CODE_RANDOM_ACCESS;
+        // Picture header or slices
+        if (header <= 0xaf)
+          return START_CODE_PICTURE;
+        return START_CODE_OTHER;
+    }
+  }
+}
+
+uint64_t TSDemux::DecodePts(const unsigned char* p)
+{
+  return (uint64_t)(p[0] & 0x0e) << 29 | (uint64_t)p[1] << 22 | (uint64_t)(p[2] >> 1) << 15 |
+         (uint64_t)p[3] << 7 | (uint64_t)(p[4] >> 1);
+}
+
+SeekIndex::SeekIndex()
+  : pid(0xffff)
+  , type(STREAM_TYPE_UNKNOWN)
+  , recovery_points(0)
+  , is_scanning(false)
+  , carry_len(0)
+{
+}
+
+void SeekIndex::Reset(uint16_t pid, STREAM_TYPE type)
+{
+  this->pid = pid;
+  this->type = type;
+  points.clear();
+  recovery_points = 0;
+  is_scanning = false;
+  carry_len = 0;
+}
+
+bool SeekIndex::AddPacket(uint64_t pos, const unsigned char* data, size_t packet_size)
+{
+  if (packet_size < FLUTS_NORMAL_TS_PACKETSIZE || data[0] != TS_SYNC_BYTE)
+    return false;
+
+  // Only the packets of the indexed stream having a payload, without transport error
+  uint16_t header = (uint16_t)(data[1] << 8 | data[2]);
+  if ((header & 0x1fff) != pid || (header & 0x8000) || !(data[3] & 0x10))
+    return true;
+
+  size_t offset = 4;
+  bool is_random_access = false;
+  if (data[3] & 0x20)
+  {
+    // Random access indicator of the adaptation field
+    if (data[4] > 0)
+      is_random_access = (data[5] & 0x40) != 0;
+    offset += 1 + data[4];
+  }
+  if (offset >= FLUTS_NORMAL_TS_PACKETSIZE)
+    return true;
+
+  const unsigned char* payload = data + offset;
+  size_t payload_len = FLUTS_NORMAL_TS_PACKETSIZE - offset;
+
+  // A PES start with a PTS begins a new access unit, the other packets continue the last one
+  bool is_pes_start = (header & 0x4000) && payload_len >= 14 && payload[0] == 0 &&
+                      payload[1] == 0 && payload[2] == 1;
+  if (!is_pes_start || !(payload[7] & 0x80))
+  {
+    if (is_scanning)
+    {
+      size_t skip = is_pes_start ? 9 + payload[8] : 0;
+      if (skip < payload_len)
+        scan_payload(payload + skip, payload_len - skip);
+    }
+    return true;
+  }
+
+  // The previous access unit has no random access point
+  if (is_scanning)
+    complete_point(false);
+
+  SEEK_POINT point;
+  point.pos = pos;
+  point.pts = DecodePts(payload + 9);
+  point.is_recovery_point = false;
+  points.push_back(point);
+  is_scanning = true;
+  carry_len = 0;
+
+  size_t pes_header_len = 9 + payload[8];
+  if (is_random_access || !has_start_codes(type))
+    complete_point(is_random_access);
+  else if (pes_header_len < payload_len)
+    scan_payload(payload + pes_header_len, payload_len - pes_header_len);
+
+  return true;
+}
+
+void SeekIndex::Finish()
+{
+  if (is_scanning)
+    complete_point(false);
+}
+
+void SeekIndex::scan_payload(const unsigned char* data, size_t len)
+{
+  // The last bytes of the previous payload are scanned again, with the new ones
+  unsigned char buffer[sizeof(carry) + FLUTS_NORMAL_TS_PACKETSIZE];
+  memcpy(buffer, carry, carry_len);
+  memcpy(buffer + carry_len, data, len);
+  size_t size = carry_len + len;
+
+  size_t pos = 0;
+  while (pos + 3 < size)
+  {
+    pos += FindStartCode(buffer + pos, size - pos);
+    // The unit header is needed, a start code at the end is scanned again with the next payload
+    if (pos + 3 >= size)
+      break;
+
+    START_CODE_TYPE start_code_type = get_start_code_type(type, buffer[pos + 3]);
+    if (start_code_type != START_CODE_OTHER)
+    {
+      complete_point(start_code_type == START_CODE_RANDOM_ACCESS);
+      return;
+    }
+    pos += 3;
+  }
+
+  carry_len = size < sizeof(carry) ? size : sizeof(carry);
+  memcpy(carry, buffer + size - carry_len, carry_len);
+}
+
+void SeekIndex::complete_point(bool is_recovery_point)
+{
+  is_scanning = false;
+  carry_len = 0;
+  if (is_recovery_point)
+  {
+    points.back().is_recovery_point = true;
+    recovery_points++;
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include "elementaryStream.h"
+
+#include <inttypes.h>
+#include <cstddef>    // for size_t
+#include <vector>
+
+namespace TSDemux
+{
+  /*
+   * Decode the 33 bits timestamp of a PES header, from its 5 bytes.
+   */
+  uint64_t DecodePts(const unsigned char* p);
+
+  struct SEEK_POINT
+  {
+    uint64_t pos;             // Position of the TS packet that starts the PES
+    uint64_t pts;
+    bool is_recovery_point;
+  };
+
+  /*
+   * Index of the PES starts of an elementary stream, made from the TS packet and
+   * PES headers only, so a seek point can be found without demuxing the packets.
+   *
+   * A PES start is a random access point when the adaptation field has the random
+   * access indicator, or when its payload has a SPS / VPS, an IDR / IRAP slice or a
+   * MPEG-1/2 sequence / GOP header before the first slice. The payload is scanned
+   * over the next packets of the PES, as the AUD and SEI units can fill the first one.
+   */
+  class SeekIndex
+  {
+  public:
+    SeekIndex();
+
+    void Reset(uint16_t pid, STREAM_TYPE type);
+
+    /*
+     * Add the next TS packet of the data. The TS packet is made of the first 188
+     * bytes, the 192 and 204 bytes packets have their extra bytes after it.
+     *
+     * returns false when the packet has not the sync byte
+     */
+    bool AddPacket(uint64_t pos, const unsigned char* data, size_t packet_size);
+
+    /*
+     * Complete the last seek point, when there are no more data
+     */
+    void Finish();
+
+    const std::vector<SEEK_POINT>& GetPoints() const { return points; }
+
+    /*
+     * The seek points that are completed, the last point can still wait for
+     * the next packets of its PES to know if it is a random access point
+     */
+    size_t GetCompletedCount() const { return is_scanning ? points.size() - 1 : points.size(); }
+    size_t GetRecoveryPointCount() const { return recovery_points; }
+    uint16_t GetPID() const { return pid; }
+
+  private:
+    void scan_payload(const unsigned char* data, size_t len);
+    void complete_point(bool is_recovery_point);
+
+    uint16_t pid;
+    STREAM_TYPE type;
+    std::vector<SEEK_POINT> points;
+    size_t recovery_points;
+    bool is_scanning;         // The payload of the last PES is scanned for start codes
+    unsigned char carry[3];   // Last bytes of the scanned payload, a start code can be split
+    size_t carry_len;
+  };
+}
+
+#endif /* SEEKINDEX_H */
@@ -7,6 +7,7 @@
  */
 
 #include "tsDemuxer.h"
+#include "byteScanner.h"
 #include "ES_MPEGVideo.h"
 #include "ES_MPEGAudio.h"
 #include "ES_h264.h"
@@ -20,6 +21,7 @@
 #include <cassert>
 
 #define MAX_RESYNC_SIZE         65536
+#define RESYNC_WINDOW_PACKETS   32
 
 using namespace TSDemux;
 
@@ -312,8 +314,11 @@ int AVContext::configure_ts()
     }
     else
     {
-      --data_size;
-      pos++;
+      // Skip to the next sync byte candidate of the data already read
+      size_t skip = FindByte(data + AV_CONTEXT_PACKETSIZE - data_size, data_size, TS_SYNC_BYTE);
+      data_size -= skip;
+      pos += skip;
+      i += static_cast<int>(skip) - 1;
     }
   }
 
@@ -331,29 +336,56 @@ int AVContext::TSResync()
     is_configured = true;
   }
 
-  size_t data_size(0);
+  if (!m_demux->ReadAV(av_pos, av_buf, av_pkt_size))
+    return AVCONTEXT_IO_ERROR;
 
-  for (int i = 0; i < MAX_RESYNC_SIZE; i++)
+  if (av_buf[0] == TS_SYNC_BYTE)
   {
-    if (!data_size)
-      data_size = m_demux->ReadAV(av_pos, av_buf, av_pkt_size) ? av_pkt_size : 0;
+    Reset();
+    return AVCONTEXT_CONTINUE;
+  }
 
-    if (!data_size)
-      return AVCONTEXT_IO_ERROR;
+  DBG(DEMUX_DBG_DEBUG, "%s: bad sync at position %" PRIu64 "\n", __FUNCTION__, av_pos);
+  return resync_window();
+}
 
-    if (av_buf[av_pkt_size - data_size] == 0x47)
+int AVContext::resync_window()
+{
+  // The sync bytes at packet stride to validate a packet start
+  const size_t sync_count = TS_CHECK_MIN_SCORE + 1;
+  const size_t window_size = RESYNC_WINDOW_PACKETS * av_pkt_size;
+  unsigned char window[RESYNC_WINDOW_PACKETS * AV_CONTEXT_PACKETSIZE];
+  uint64_t start_pos = av_pos;
+
+  // Search on a window of packets, instead of shifting by one byte and reading again
+  while (av_pos - start_pos < MAX_RESYNC_SIZE && m_demux->ReadAV(av_pos, window, window_size))
+  {
+    size_t offset = FindPacketSync(window, window_size, av_pkt_size, sync_count);
+    if (offset < window_size)
     {
-      if (data_size != av_pkt_size)
-        data_size = m_demux->ReadAV(av_pos, av_buf, av_pkt_size) ? av_pkt_size : 0;
+      av_pos += offset;
+      memcpy(av_buf, window + offset, av_pkt_size);
+      Reset();
+      return AVCONTEXT_CONTINUE;
+    }
+    // The candidates of the last packets have not been validated, check them with the next window
+    av_pos += window_size - (sync_count - 1) * av_pkt_size;
+  }
 
-      if (data_size)
-      {
-        Reset();
-        return AVCONTEXT_CONTINUE;
-      }
+  // Not enough data for a window, e.g. at the end of the segment, so the packet stride
+  // cannot be validated: take the first sync byte found
+  while (av_pos - start_pos < MAX_RESYNC_SIZE)
+  {
+    if (!m_demux->ReadAV(av_pos, av_buf, av_pkt_size))
+      return AVCONTEXT_IO_ERROR;
+
+    size_t offset = FindByte(av_buf, av_pkt_size, TS_SYNC_BYTE);
+    if (offset == 0)
+    {
+      Reset();
+      return AVCONTEXT_CONTINUE;
     }
-    av_pos++;
-    --data_size;
+    av_pos += offset;
   }
 
   return AVCONTEXT_TS_NOSYNC;
@@ -71,6 +71,7 @@ namespace TSDemux
     uint64_t GetPosition() const;
     uint64_t GetRecoveryPos() { return payload_unit_pos ? payload_unit_pos : av_pos; };
     uint64_t GetNextPosition() const;
+    size_t GetPacketSize() const { return av_pkt_size; };
     int ProcessTSPacket();
     int ProcessTSPayload();
 
@@ -79,6 +80,7 @@ namespace TSDemux
     AVContext& operator=(const AVContext&);
 
     int configure_ts();
+    int resync_window();
     static STREAM_TYPE get_stream_type(uint8_t pes_type);
     static uint8_t av_rb8(const unsigned char* p);
     static uint16_t av_rb16(const unsigned char* p);
@@ -8,6 +8,7 @@
 
 #include "ADTSReader.h"
 
+#include "AdaptiveByteStream.h"
 #include "parser/CodecParser.h"
 #include "utils/log.h"
 #include "utils/Utils.h"
@@ -124,6 +125,28 @@ void ADTSFrame::AdjustStreamForPadding(AP4_ByteStream* stream)
     stream->Seek(currentPos);
 }
 
+bool ADTSFrame::ReadFrameData(AP4_ByteStream* stream)
+{
+  // The frame data are not modified, so when possible refer to the segment buffer
+  // data, then the only copy will be done to fill the demux packet
+  auto adByteStream = dynamic_cast<CAdaptiveByteStream*>(stream);
+  if (adByteStream && adByteStream->ReadView(m_frameInfo.m_frameSize, m_frameData))
+  {
+    m_frameDataSize = m_frameInfo.m_frameSize;
+    return true;
+  }
+
+  m_frameData = nullptr;
+  m_frameDataSize = 0;
+  m_dataBuffer.SetDataSize(m_frameInfo.m_frameSize);
+  if (!AP4_SUCCEEDED(stream->Read(m_dataBuffer.UseData(), m_dataBuffer.GetDataSize())))
+    return false;
+
+  m_frameData = m_dataBuffer.GetData();
+  m_frameDataSize = m_dataBuffer.GetDataSize();
+  return true;
+}
+
 ADTSFrame::ADTSFrameInfo ADTSFrame::GetFrameInfo(AP4_ByteStream* stream)
 {
   ADTSFrameInfo frameInfo;
@@ -178,8 +201,7 @@ bool ADTSFrame::ParseAac(AP4_ByteStream* stream)
   stream->Tell(currentPos);
   stream->Seek(currentPos - (AP4_ADTS_HEADER_SIZE));
 
-  m_dataBuffer.SetDataSize(m_frameInfo.m_frameSize);
-  if (!AP4_SUCCEEDED(stream->Read(m_dataBuffer.UseData(), m_dataBuffer.GetDataSize())))
+  if (!ReadFrameData(stream))
     return false;
 
   AdjustStreamForPadding(stream);
@@ -223,8 +245,7 @@ bool ADTSFrame::ParseAc3(AP4_ByteStream* stream)
   stream->Tell(currentPos);
   stream->Seek(currentPos - (AP4_AC3_HEADER_SIZE));
 
-  m_dataBuffer.SetDataSize(m_frameInfo.m_frameSize);
-  if (!AP4_SUCCEEDED(stream->Read(m_dataBuffer.UseData(), m_dataBuffer.GetDataSize())))
+  if (!ReadFrameData(stream))
     return false;
 
   AdjustStreamForPadding(stream);
@@ -267,8 +288,7 @@ bool ADTSFrame::ParseEc3(AP4_ByteStream* stream)
   stream->Tell(currentPos);
   stream->Seek(currentPos - (AP4_EAC3_HEADER_SIZE));
 
-  m_dataBuffer.SetDataSize(m_frameInfo.m_frameSize);
-  if (!AP4_SUCCEEDED(stream->Read(m_dataBuffer.UseData(), m_dataBuffer.GetDataSize())))
+  if (!ReadFrameData(stream))
     return false;
 
   AdjustStreamForPadding(stream);
@@ -314,6 +334,8 @@ void ADTSFrame::reset()
   m_summedFrameCount = 0;
   m_frameInfo.m_frameCount = 0;
   m_dataBuffer.SetDataSize(0);
+  m_frameData = nullptr;
+  m_frameDataSize = 0;
 }
 
 uint64_t ADTSFrame::getPtsOffset() const
@@ -74,6 +74,12 @@ public:
    * \param stream The stream to check
    */
   void AdjustStreamForPadding(AP4_ByteStream* stream);
+  /*!
+   * \brief Read the data of the frame, when possible as a view of the stream data without copy
+   * \param stream The stream positioned at the beginning of the frame
+   * \return True if success, otherwise false
+   */
+  bool ReadFrameData(AP4_ByteStream* stream);
   ADTSFrameInfo GetFrameInfo(AP4_ByteStream* stream);
   bool parse(AP4_ByteStream *stream);
   bool ParseAac(AP4_ByteStream* stream);
@@ -86,13 +92,16 @@ public:
   void resetFrameCount() { m_summedFrameCount = 0; }
   uint64_t getPtsOffset() const;
   uint64_t getDuration() const;
-  const AP4_Byte *getData() const { return m_dataBuffer.GetData(); }
-  AP4_Size getDataSize() const { return m_dataBuffer.GetDataSize(); }
+  const AP4_Byte *getData() const { return m_frameData; }
+  AP4_Size getDataSize() const { return m_frameDataSize; }
 
 private:
   uint64_t m_summedFrameCount{0};
   ADTSFrameInfo m_frameInfo;
   AP4_DataBuffer m_dataBuffer;
+  // The frame data, can point to m_dataBuffer or to a view of the stream data
+  const AP4_Byte* m_frameData{nullptr};
+  AP4_Size m_frameDataSize{0};
 };
 
 class ATTR_DLL_LOCAL ADTSReader
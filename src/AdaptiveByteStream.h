@@ -34,6 +34,39 @@ public:
   AP4_Result GetSize(AP4_LargeSize& size) override;
   AP4_Result GetSegmentSize(size_t& size);
 
+  /*!
+   * \brief Read the data as a view of the segment buffer, without copying them,
+   *        the view is valid until the next call. Refer to AdaptiveStream::ReadView.
+   * \param size The bytes to read
+   * \param data[OUT] The pointer to the data
+   * \return True if success, otherwise false and the data must be read with Read
+   */
+  bool ReadView(AP4_Size size, const AP4_Byte*& data) { return m_adStream->ReadView(size, data); }
+
+  /*!
+   * \brief Get a view of the current segment data, without advancing the position.
+   *        Refer to AdaptiveStream::PeekView.
+   */
+  bool PeekView(const AP4_Byte*& data, size_t& size) { return m_adStream->PeekView(data, size); }
+
+  /*!
+   * \brief Advance the position over the data read from the view given by PeekView.
+   *        Refer to AdaptiveStream::SkipView.
+   */
+  bool SkipView(size_t size) { return m_adStream->SkipView(size); }
+
+  /*!
+   * \brief Wait for the data of the current segment, without switching to the next one.
+   *        Refer to AdaptiveStream::WaitSegmentData.
+   */
+  size_t WaitSegmentData(uint64_t pos, size_t size) { return m_adStream->WaitSegmentData(pos, size); }
+
+  /*!
+   * \brief Get the identifier of the current segment data.
+   *        Refer to AdaptiveStream::GetSegmentDataId.
+   */
+  adaptive::AdaptiveStream::SEGMENTDATAID GetSegmentDataId() { return m_adStream->GetSegmentDataId(); }
+
   // AP4_Referenceable methods
   void AddReference() override{};
   void Release() override{};
@@ -25,7 +25,9 @@
 #include "utils/Utils.h"
 #include "utils/log.h"
 
+#include <algorithm>
 #include <array>
+#include <cinttypes>
 
 #include <kodi/addon-instance/Inputstream.h>
 
@@ -224,6 +226,13 @@ bool CSession::Initialize()
 
   m_adaptiveTree->PostOpen(m_kodiProps);
 
+  m_downloadScheduler = std::make_unique<adaptive::CDownloadScheduler>(
+      m_adaptiveTree->m_settings.m_sessionMaxDownloads);
+  m_bufferBudget = std::make_unique<adaptive::CBufferBudget>(
+      static_cast<uint64_t>(m_adaptiveTree->m_settings.m_sessionMaxBufferSize) * 1024 * 1024);
+  m_segmentBufferPool =
+      std::make_unique<adaptive::CSegmentBufferPool>(m_bufferBudget->GetMaxBytes());
+
   bool isPeriodInit = InitializePeriod(isSessionOpened);
   m_reprChooser->PostInit();
   return isPeriodInit;
@@ -579,8 +588,22 @@ bool CSession::InitializePeriod(bool isSessionOpened /* = false */)
   }
 
   // create SESSION::STREAM objects. One for each AdaptationSet
+  InvalidateSampleQueue();
   m_streams.clear();
 
+  // The segment buffers of the previous period have been released to the pool,
+  // the new period can have different segment sizes, so return the memory
+  if (m_segmentBufferPool)
+  {
+    const adaptive::CSegmentBufferPool::Stats stats = m_segmentBufferPool->GetStats();
+    LOG::Log(LOGDEBUG,
+             "Segment buffer pool high-water marks: in use %" PRIu64 " KiB, cached %" PRIu64
+             " KiB, total %" PRIu64 " KiB (allocations %" PRIu64 ", reuses %" PRIu64 ")",
+             stats.m_peakInUseBytes / 1024, stats.m_peakCachedBytes / 1024,
+             stats.m_peakTotalBytes / 1024, stats.m_allocations, stats.m_reuses);
+    m_segmentBufferPool->Trim();
+  }
+
   if (!isPsshChanged)
   {
     if (isReusePssh)
@@ -657,6 +680,9 @@ void CSession::AddStream(PLAYLIST::CAdaptationSet* adp,
   m_streams.push_back(std::make_unique<CStream>(*m_adaptiveTree, adp, initialRepr, m_kodiProps));
 
   CStream& stream{*m_streams.back()};
+  stream.m_adStream.SetDownloadScheduler(m_downloadScheduler.get());
+  stream.m_adStream.SetBufferBudget(m_bufferBudget.get());
+  stream.m_adStream.SetSegmentBufferPool(m_segmentBufferPool.get());
 
   uint32_t flags{INPUTSTREAM_FLAG_NONE};
   stream.m_info.SetName(adp->GetName());
@@ -913,17 +939,36 @@ void CSession::PrepareStream(CStream* stream, bool& needRefetch)
 
 void CSession::EnableStream(CStream* stream, bool enable)
 {
+  InvalidateSampleQueue();
+
   if (enable)
   {
     if (!m_timingStream)
+    {
       m_timingStream = stream;
+      stream->m_adStream.SetIsTimingStream(true);
+    }
+
+    // Subtitles are read on demand, without read-ahead
+    ISampleReader* reader{stream->GetReader()};
+    if (reader && stream->m_info.GetStreamType() != INPUTSTREAM_TYPE_SUBTITLE)
+    {
+      adaptive::AdaptiveStream* adStream{&stream->m_adStream};
+      // Samples are read ahead only from the current segment, so the read-ahead never
+      // wait for the download of the next segment
+      reader->SetReadAhead(m_adaptiveTree->m_settings.m_sampleReadAhead,
+                           [adStream] { return adStream->HasSegmentDataToRead(); });
+    }
 
     stream->m_isEnabled = true;
   }
   else
   {
     if (stream == m_timingStream)
+    {
       m_timingStream = nullptr;
+      stream->m_adStream.SetIsTimingStream(false);
+    }
 
     stream->Disable();
   }
@@ -941,7 +986,7 @@ uint64_t CSession::PTSToElapsed(uint64_t pts)
     }
 
     // adjusted pts value taking the difference between segment's pts and reader pts
-    int64_t manifest_time{static_cast<int64_t>(pts) - timingReader->GetPTSDiff()};
+    int64_t manifest_time{static_cast<int64_t>(pts) - timingReader->GetDemuxPTSDiff()};
     if (manifest_time < 0)
       manifest_time = 0;
 
@@ -965,7 +1010,7 @@ uint64_t CSession::GetTimeshiftBufferStart()
       LOG::LogF(LOGERROR, "Cannot get the stream sample reader");
       return 0ULL;
     }
-    return m_timingStream->m_adStream.GetAbsolutePTSOffset() + timingReader->GetPTSDiff();
+    return m_timingStream->m_adStream.GetAbsolutePTSOffset() + timingReader->GetDemuxPTSDiff();
   }
   else
     return 0ULL;
@@ -996,6 +1041,7 @@ void CSession::StartReader(
     return;
   }
 
+  streamReader->ClearReadAhead();
   if (bReset)
     streamReader->Reset(false);
 
@@ -1012,84 +1058,153 @@ void CSession::SetVideoResolution(int width, int height, int maxWidth, int maxHe
 
 bool CSession::GetNextSample(ISampleReader*& sampleReader)
 {
-  CStream* res{nullptr};
-  CStream* waiting{nullptr};
+  // Advice is that VP does not want to wait longer than 10ms for a return from
+  // DemuxRead() - here we ask to not wait at all and if ReadSample has not yet
+  // finished we return the dummy reader instead
+  const bool isWaiting{m_isSampleQueueValid ? UpdateSampleQueue() : FillSampleQueue()};
+
+  if (isWaiting)
+    return true;
+
+  if (m_sampleQueue.empty())
+    return false;
+
+  CStream* res{m_streams[m_sampleQueue.front().m_streamIndex].get()};
+
+  if (res->m_adStream.waitingForSegment(true))
+    return true;
+
+  if (res->m_hasSegmentChanged)
+  {
+    OnSegmentChangedRead(res);
+    res->m_hasSegmentChanged = false;
+  }
+
+  ISampleReader* sr{res->GetReader()};
+  const uint64_t pts{sr->GetDemuxSample().m_pts};
+
+  if (pts != STREAM_NOPTS_VALUE)
+    m_elapsedTime = PTSToElapsed(pts) + GetChapterStartTime();
+
+  sampleReader = sr;
+  return true;
+}
+
+bool CSession::FillSampleQueue()
+{
+  InvalidateSampleQueue();
+
   CStream* timingStream{GetTimingStream()};
+  bool isQueueValid{true};
 
+  // Pause the read-ahead, the reader state is accessed here, also the one of the timing
+  // stream by the other streams. It is resumed by the next ReadSampleAsync
   for (auto& stream : m_streams)
   {
-    bool isStarted{false};
     ISampleReader* streamReader{stream->GetReader()};
-    if (!streamReader)
+    if (!streamReader || !stream->m_isEnabled)
       continue;
 
-    if (stream->m_isEnabled)
+    if (streamReader->IsReadSampleAsyncWorking())
     {
-      // Advice is that VP does not want to wait longer than 10ms for a return from
-      // DemuxRead() - here we ask to not wait at all and if ReadSample has not yet
-      // finished we return the dummy reader instead
-      if (streamReader->IsReadSampleAsyncWorking())
-      {
-        waiting = stream.get();
-        break;
-      }
-      else if (!streamReader->EOS())
-      {
-        // Once the start PTS has been acquired for the timing stream, set this value
-        // to the other stream readers
-        if (timingStream && stream.get() != timingStream &&
-            timingStream->GetReader()->GetStartPTS() != STREAM_NOPTS_VALUE &&
-            streamReader->GetStartPTS() == STREAM_NOPTS_VALUE)
-        {
-          // want this to be the internal data's (not segment's) pts of
-          // the first segment in period
-          streamReader->SetStartPTS(GetTimingStartPTS());
-        }
-        if (AP4_SUCCEEDED(streamReader->Start(isStarted)))
-        {
-          if (!res || streamReader->DTSorPTS() < res->GetReader()->DTSorPTS())
-          {
-            if (stream->m_adStream.waitingForSegment(true))
-            {
-              waiting = stream.get();
-            }
-            else
-            {
-              res = stream.get();
-            }
-          }
-        }
-      }
+      m_sampleQueue.clear();
+      return true;
     }
+    streamReader->WaitReadSampleAsyncComplete();
   }
 
-  if (waiting)
+  for (size_t index = 0; index < m_streams.size(); ++index)
   {
-    return true;
-  }
-  else if (res)
-  {
-    if (res->m_hasSegmentChanged)
+    CStream* stream{m_streams[index].get()};
+    ISampleReader* streamReader{stream->GetReader()};
+    if (!streamReader || !stream->m_isEnabled)
+      continue;
+
+    if (streamReader->GetDemuxSample().m_isEOS)
+      continue;
+
+    // Once the start PTS has been acquired for the timing stream, set this value
+    // to the other stream readers
+    if (timingStream && stream != timingStream &&
+        timingStream->GetReader()->GetStartPTS() != STREAM_NOPTS_VALUE &&
+        streamReader->GetStartPTS() == STREAM_NOPTS_VALUE)
+    {
+      // want this to be the internal data's (not segment's) pts of
+      // the first segment in period
+      streamReader->SetStartPTS(GetTimingStartPTS());
+    }
+
+    bool isStarted{false};
+    if (AP4_SUCCEEDED(streamReader->Start(isStarted)))
+    {
+      m_sampleQueue.push_back({streamReader->GetDemuxSample().m_dtsOrPts, index, streamReader,
+                               streamReader->GetReadSampleCount()});
+    }
+    else
     {
-      OnSegmentChangedRead(res);
-      res->m_hasSegmentChanged = false;
+      isQueueValid = false;
     }
 
-    ISampleReader* sr{res->GetReader()};
+    // Until the start PTS is known the streams must be checked on each call, to set it
+    if (streamReader->GetStartPTS() == STREAM_NOPTS_VALUE)
+      isQueueValid = false;
+  }
+
+  std::make_heap(m_sampleQueue.begin(), m_sampleQueue.end(), SampleQueueItem::IsAfter);
+  m_isSampleQueueValid = isQueueValid;
+  return false;
+}
 
-    if (sr->PTS() != STREAM_NOPTS_VALUE)
-      m_elapsedTime = PTSToElapsed(sr->PTS()) + GetChapterStartTime();
+bool CSession::UpdateSampleQueue()
+{
+  if (m_sampleQueue.empty())
+    return false;
 
-    sampleReader = sr;
+  const SampleQueueItem& top{m_sampleQueue.front()};
+  CStream* stream{m_streams[top.m_streamIndex].get()};
+  ISampleReader* streamReader{stream->GetReader()};
+
+  // The sample reader has been replaced, e.g. by a stream change
+  if (!stream->m_isEnabled || streamReader != top.m_reader)
+    return FillSampleQueue();
+
+  const uint64_t readCount{streamReader->GetReadSampleCount()};
+  // The sample has not been demuxed yet
+  if (readCount == top.m_readCount)
+    return false;
+
+  if (streamReader->IsReadSampleAsyncWorking())
     return true;
+
+  std::pop_heap(m_sampleQueue.begin(), m_sampleQueue.end(), SampleQueueItem::IsAfter);
+
+  const ISampleReader::DemuxSample sample{streamReader->GetDemuxSample()};
+  if (sample.m_isEOS)
+  {
+    m_sampleQueue.pop_back();
+  }
+  else
+  {
+    m_sampleQueue.back().m_dtsOrPts = sample.m_dtsOrPts;
+    m_sampleQueue.back().m_readCount = readCount;
+    std::push_heap(m_sampleQueue.begin(), m_sampleQueue.end(), SampleQueueItem::IsAfter);
   }
   return false;
 }
 
+void CSession::InvalidateSampleQueue()
+{
+  m_sampleQueue.clear();
+  m_isSampleQueueValid = false;
+}
+
 bool CSession::SeekTime(double seekTime, unsigned int streamId, bool preceeding)
 {
   bool ret{false};
 
+  // The sample readers are repositioned
+  InvalidateSampleQueue();
+
   //we don't have pts < 0 here and work internally with uint64
   if (seekTime < 0)
     seekTime = 0;
@@ -1178,6 +1293,8 @@ bool CSession::SeekTime(double seekTime, unsigned int streamId, bool preceeding)
     streamReader->WaitReadSampleAsyncComplete();
     if (stream->m_isEnabled && (streamId == 0 || stream->m_info.GetPhysicalIndex() == streamId))
     {
+      // The reader is repositioned, so the samples read ahead are no longer valid
+      streamReader->ClearReadAhead();
       bool reset{true};
       // all streams must be started before seeking to ensure cross chapter seeks
       // will seek to the correct location/segment
@@ -1258,6 +1375,9 @@ void CSession::OnSegmentChangedRead(CStream* stream)
     ISampleReader* sr = stream->GetReader();
     uint64_t duration;
 
+    // Pause the read-ahead, the reader state is accessed here
+    sr->WaitReadSampleAsyncComplete();
+
     if (sr->GetFragmentInfo(duration))
     {
       adaptive::AdaptiveStream& adStream = stream->m_adStream;
@@ -1424,12 +1544,14 @@ bool CSession::SeekChapter(int ch)
     LOG::LogF(LOGDEBUG, "Switching to new Period (id=%s, start=%ld, seq=%d)",
               nextPeriod->GetId().data(), nextPeriod->GetStart(), nextPeriod->GetSequence());
 
+    InvalidateSampleQueue();
     for (auto& stream : m_streams)
     {
       ISampleReader* sr{stream->GetReader()};
       if (sr)
       {
         sr->WaitReadSampleAsyncComplete();
+        sr->ClearReadAhead();
         sr->Reset(true);
       }
     }
@@ -351,6 +351,25 @@ protected:
    */
   void OnSegmentChangedRead(CStream* stream);
 
+  /*!
+   * \brief Rebuild the sample queue by checking all the enabled streams.
+   * \return True if a sample reader is still reading, so the next sample is not known yet
+   */
+  bool FillSampleQueue();
+
+  /*!
+   * \brief Update the sample queue position of the stream at the top of the queue,
+   *        when its sample reader has been advanced, the other streams are not changed.
+   * \return True if the sample reader is still reading, so the next sample is not known yet
+   */
+  bool UpdateSampleQueue();
+
+  /*!
+   * \brief Discard the sample queue, it will be rebuilt on the next GetNextSample call.
+   *        To be called when the streams or the sample readers positions are changed.
+   */
+  void InvalidateSampleQueue();
+
   /*! \brief Check for and load decrypter module matching the supplied key system
    *  \param key_system [OUT] Will be assigned to if a decrypter is found matching
    *                    the set license type
@@ -389,9 +408,32 @@ private:
   adaptive::AdaptiveTree* m_adaptiveTree{nullptr};
   CHOOSER::IRepresentationChooser* m_reprChooser;
 
+  // Must be declared before the streams, that use it
+  std::unique_ptr<adaptive::CDownloadScheduler> m_downloadScheduler;
+  std::unique_ptr<adaptive::CBufferBudget> m_bufferBudget;
+  std::unique_ptr<adaptive::CSegmentBufferPool> m_segmentBufferPool;
   std::vector<std::unique_ptr<CStream>> m_streams;
   CStream* m_timingStream{nullptr};
 
+  struct SampleQueueItem
+  {
+    uint64_t m_dtsOrPts; // Timestamp of the next sample of the stream
+    size_t m_streamIndex; // Index in m_streams, to keep the streams order on same timestamp
+    ISampleReader* m_reader;
+    uint64_t m_readCount; // ISampleReader::GetReadSampleCount value when the item was queued
+
+    // Comparator for a min-heap on the sample timestamp
+    static bool IsAfter(const SampleQueueItem& left, const SampleQueueItem& right)
+    {
+      if (left.m_dtsOrPts != right.m_dtsOrPts)
+        return left.m_dtsOrPts > right.m_dtsOrPts;
+      return left.m_streamIndex > right.m_streamIndex;
+    }
+  };
+  // Min-heap of the enabled streams that are not at end of stream, by next sample timestamp
+  std::vector<SampleQueueItem> m_sampleQueue;
+  bool m_isSampleQueueValid{false};
+
   bool m_changed{false};
   uint64_t m_elapsedTime{0};
   uint64_t m_chapterStartTime{0}; // In STREAM_TIME_BASE
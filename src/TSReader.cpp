@@ -8,11 +8,15 @@
 
 #include "TSReader.h"
 
+#include "AdaptiveByteStream.h"
 #include "mpegts/ES_AAC.h"
 #include "mpegts/debug.h"
+#include "mpegts/seekIndex.h"
 #include "utils/Utils.h"
 #include "utils/log.h"
 
+#include <cinttypes>
+#include <cstring>
 #include <stdlib.h>
 
 #include <bento4/Ap4ByteStream.h>
@@ -21,6 +25,9 @@ using namespace UTILS;
 
 namespace
 {
+// Segment data waited for at once when indexing, in packets
+constexpr size_t SEEK_INDEX_WINDOW_PACKETS = 64;
+
 void DebugLog(int level, char* msg)
 {
   if (msg[std::strlen(msg) - 1] == '\n')
@@ -49,7 +56,12 @@ void DebugLog(int level, char* msg)
 } // unnamed namespace
 
 TSReader::TSReader(AP4_ByteStream* stream, uint32_t requiredMask)
-  : m_stream(stream), m_requiredMask(requiredMask), m_typeMask(0), m_startPts{STREAM_NOPTS_VALUE}
+  : m_stream(stream),
+    m_adByteStream(dynamic_cast<CAdaptiveByteStream*>(stream)),
+    m_streamPos(~0ULL),
+    m_requiredMask(requiredMask),
+    m_typeMask(0),
+    m_startPts{STREAM_NOPTS_VALUE}
 {
   // Uncomment to debug TSDemux library
   // TSDemux::DBGAll();
@@ -72,19 +84,63 @@ bool TSReader::Initialize()
 
 TSReader::~TSReader()
 {
+  LOG::Log(LOGDEBUG,
+           "TS packets read from the segment view: %" PRIu64 ", from the stream: %" PRIu64,
+           m_windowReads, m_streamReads);
   delete m_AVContext;
   m_AVContext = nullptr;
 }
 
 bool TSReader::ReadAV(uint64_t pos, unsigned char * data, size_t len)
 {
-  m_stream->Seek(pos);
-  return AP4_SUCCEEDED(m_stream->Read(data, static_cast<AP4_Size>(len)));
+  // Fast path for the sequential reads, the data are copied from the view of the
+  // segment buffer and the stream position is advanced without locking
+  if (m_adByteStream && pos == m_streamPos)
+  {
+    if (pos < m_windowPos || pos + len > m_windowPos + m_windowSize)
+    {
+      if (m_adByteStream->PeekView(m_windowData, m_windowSize))
+        m_windowPos = pos;
+      else
+        ResetWindow();
+    }
+
+    if (pos >= m_windowPos && pos + len <= m_windowPos + m_windowSize &&
+        m_adByteStream->SkipView(len))
+    {
+      std::memcpy(data, m_windowData + (pos - m_windowPos), len);
+      m_streamPos = pos + len;
+      m_windowReads++;
+      return true;
+    }
+  }
+
+  if (pos != m_streamPos)
+    m_stream->Seek(pos);
+
+  m_streamReads++;
+  if (AP4_SUCCEEDED(m_stream->Read(data, static_cast<AP4_Size>(len))))
+  {
+    m_streamPos = pos + len;
+    return true;
+  }
+  m_streamPos = ~0ULL;
+  return false;
+}
+
+void TSReader::ResetWindow()
+{
+  m_windowData = nullptr;
+  m_windowPos = 0;
+  m_windowSize = 0;
 }
 
 void TSReader::Reset(bool resetPackets)
 {
+  // The stream can have been repositioned, e.g. by a seek, so the window is no longer valid
+  ResetWindow();
   m_stream->Tell(m_startPos);
+  m_streamPos = static_cast<uint64_t>(m_startPos);
   m_AVContext->GoPosition(m_startPos, resetPackets);
   //mark invalid for Seek operations
   m_pkt.pts = PTS_UNSET;
@@ -206,8 +262,70 @@ bool TSReader::GetInformation(kodi::addon::InputstreamInfo& info)
   return isChanged;
 }
 
-// We assume that m_startpos is the current I-Frame position
 bool TSReader::SeekTime(uint64_t timeInTs, bool preceeding)
+{
+  // The index is made on the video stream, or on the first enabled stream if there is no video
+  const TSINFO* seekInfo{nullptr};
+  for (const auto& tsInfo : m_streamInfos)
+  {
+    if (!tsInfo.m_enabled)
+      continue;
+    if (tsInfo.m_streamType == INPUTSTREAM_TYPE_VIDEO)
+    {
+      seekInfo = &tsInfo;
+      break;
+    }
+    if (!seekInfo)
+      seekInfo = &tsInfo;
+  }
+  if (!seekInfo || !m_adByteStream || !m_AVContext->GetPacketSize())
+    return SeekTimeDecode(timeInTs, preceeding);
+
+  // The index is kept while the seeks are on the same segment data, and is made only over
+  // the data not indexed yet, the positions are not unique between the segments
+  const bool isVideo{seekInfo->m_streamType == INPUTSTREAM_TYPE_VIDEO};
+  const adaptive::AdaptiveStream::SEGMENTDATAID segmentId{m_adByteStream->GetSegmentDataId()};
+  if (segmentId != m_seekIndexSegment || seekInfo->m_stream->pid != m_seekIndex.GetPID())
+    ResetSeekIndex(segmentId, seekInfo->m_stream->pid, seekInfo->m_stream->stream_type);
+
+  // The index is made from the segment start, only up to the seek point
+  const std::vector<TSDemux::SEEK_POINT>& seekPoints = m_seekIndex.GetPoints();
+  constexpr size_t NO_INDEX{static_cast<size_t>(-1)};
+  size_t recoveryIndex{NO_INDEX};
+  bool isFound{false};
+  for (size_t i = 0; i < m_seekIndex.GetCompletedCount() || IndexNextSeekPoint(); ++i)
+  {
+    // As for the decoding seek, the segment is assumed to start with a recovery point
+    if (!isVideo || i == 0 || seekPoints[i].is_recovery_point)
+    {
+      if (preceeding || seekPoints[i].pts >= timeInTs)
+        recoveryIndex = i;
+    }
+    if (seekPoints[i].pts >= timeInTs && (preceeding || recoveryIndex == i))
+    {
+      isFound = true;
+      break;
+    }
+  }
+
+  // Decode the packets when the seek point is not in the current segment, the stream needs
+  // a resync, or the recovery points cannot be found from the headers
+  if (!isFound || recoveryIndex == NO_INDEX || m_isSeekIndexSyncLost ||
+      (isVideo && m_seekIndex.GetRecoveryPointCount() == 0))
+  {
+    LOG::Log(LOGDEBUG, "TS seek index not usable for PID %u, seek by decoding the packets",
+             m_seekIndex.GetPID());
+    return SeekTimeDecode(timeInTs, preceeding);
+  }
+
+  m_AVContext->GoPosition(
+      recoveryIndex == 0 ? m_seekIndexSegment.m_startPos : seekPoints[recoveryIndex].pos, true);
+
+  return true;
+}
+
+// We assume that m_startpos is the current I-Frame position
+bool TSReader::SeekTimeDecode(uint64_t timeInTs, bool preceeding)
 {
   bool hasVideo(false);
   //look if we have video
@@ -236,6 +354,61 @@ bool TSReader::SeekTime(uint64_t timeInTs, bool preceeding)
   return true;
 }
 
+void TSReader::ResetSeekIndex(const adaptive::AdaptiveStream::SEGMENTDATAID& segmentId,
+                              uint16_t pid,
+                              TSDemux::STREAM_TYPE type)
+{
+  m_seekIndex.Reset(pid, type);
+  m_seekIndexSegment = segmentId;
+  m_seekIndexPos = segmentId.m_startPos;
+  m_seekIndexDataEnd = m_seekIndexPos;
+  m_isSeekIndexEnd = false;
+  m_isSeekIndexSyncLost = false;
+}
+
+bool TSReader::IndexNextSeekPoint()
+{
+  const size_t packetSize{m_AVContext->GetPacketSize()};
+  const size_t completedCount{m_seekIndex.GetCompletedCount()};
+  unsigned char packet[AV_CONTEXT_PACKETSIZE];
+
+  while (!m_isSeekIndexEnd)
+  {
+    const uint64_t packetPos{m_seekIndexPos};
+
+    // Only the data of the current segment, a read beyond it would switch to the next segment
+    if (packetPos + packetSize > m_seekIndexDataEnd)
+    {
+      m_seekIndexDataEnd =
+          packetPos + m_adByteStream->WaitSegmentData(packetPos, SEEK_INDEX_WINDOW_PACKETS * packetSize);
+      if (packetPos + packetSize > m_seekIndexDataEnd)
+      {
+        m_seekIndex.Finish();
+        m_isSeekIndexEnd = true;
+        break;
+      }
+    }
+
+    if (!ReadAV(packetPos, packet, packetSize))
+    {
+      m_seekIndex.Finish();
+      m_isSeekIndexEnd = true;
+      break;
+    }
+    if (!m_seekIndex.AddPacket(packetPos, packet, packetSize))
+    {
+      m_isSeekIndexEnd = true;
+      m_isSeekIndexSyncLost = true;
+      break;
+    }
+    m_seekIndexPos += packetSize;
+
+    if (m_seekIndex.GetCompletedCount() > completedCount)
+      return true;
+  }
+  return m_seekIndex.GetCompletedCount() > completedCount;
+}
+
 bool TSReader::ReadPacket(bool scanStreamInfo)
 {
   if (!m_AVContext)
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include "common/AdaptiveStream.h"
+#include "mpegts/seekIndex.h"
 #include "mpegts/tsDemuxer.h"
 
 #include <stdint.h>
@@ -17,6 +19,7 @@
 #include <kodi/addon-instance/Inputstream.h>
 
 class AP4_ByteStream;
+class CAdaptiveByteStream;
 
 class ATTR_DLL_LOCAL TSReader : public TSDemux::TSDemuxer
 {
@@ -47,10 +50,36 @@ private:
   bool GetPacket();
   bool HandleProgramChange();
   bool HandleStreamChange(uint16_t pid);
+  void ResetWindow();
+  bool SeekTimeDecode(uint64_t timeInTs, bool preceeding);
+  void ResetSeekIndex(const adaptive::AdaptiveStream::SEGMENTDATAID& segmentId,
+                      uint16_t pid,
+                      TSDemux::STREAM_TYPE type);
+  bool IndexNextSeekPoint();
 
   TSDemux::AVContext* m_AVContext;
 
   AP4_ByteStream *m_stream;
+  CAdaptiveByteStream* m_adByteStream;
+
+  // Window on the current segment data of the adaptive stream, the packets read
+  // sequentially are copied from it without seeking and reading the stream
+  const AP4_Byte* m_windowData{nullptr};
+  uint64_t m_windowPos{0};
+  size_t m_windowSize{0};
+  uint64_t m_streamPos; // The stream position after the last read, or ~0 if unknown
+  uint64_t m_windowReads{0};
+  uint64_t m_streamReads{0};
+
+  // Index of the PES starts of a stream in the current segment, read from the TS packet and
+  // PES headers only, so a seek does not need to demux all the packets before the seek point.
+  // It is kept between the seeks on the same segment data, and extended as the data arrive
+  TSDemux::SeekIndex m_seekIndex;
+  adaptive::AdaptiveStream::SEGMENTDATAID m_seekIndexSegment;
+  uint64_t m_seekIndexPos{0}; // Position of the next packet to be indexed
+  uint64_t m_seekIndexDataEnd{0}; // End of the segment data available to be indexed
+  bool m_isSeekIndexEnd{false};
+  bool m_isSeekIndexSyncLost{false};
 
   TSDemux::STREAM_PKT m_pkt;
   AP4_Position m_startPos;
@@ -20,7 +20,9 @@
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <deque>
 #include <iostream>
+#include <random>
 
 #include <bento4/Ap4.h>
 #include "kodi/tools/StringUtils.h"
@@ -31,6 +33,58 @@ using namespace kodi::tools;
 using namespace PLAYLIST;
 using namespace UTILS;
 
+namespace
+{
+// Interval between the evaluations to abandon a download
+constexpr double ABANDON_CHECK_INTERVAL = 0.1; // Seconds
+// Min transfer time before evaluate to abandon a download, to have a reliable transfer rate
+constexpr double ABANDON_MIN_TRANSFER_DURATION = 0.5; // Seconds
+// Downloads with more than this percentage of data transferred are never abandoned
+constexpr double ABANDON_MAX_PROGRESS = 0.8;
+
+// Bounds of the number of segment buffers, the buffer itself is governed by duration and memory
+constexpr uint32_t MIN_SEGMENT_BUFFERS = 4;
+constexpr uint32_t MAX_SEGMENT_BUFFERS = 128;
+// Number of segment buffers used when the segment duration is unknown
+constexpr uint32_t DEFAULT_SEGMENT_BUFFERS = 8;
+// The segment in reading and the next one are always admitted in the buffer, to ensure progress
+constexpr size_t MIN_ADMITTED_SEGMENTS = 2;
+
+double GetSegmentDurationSecs(const PLAYLIST::CSegment& segment, const PLAYLIST::CRepresentation* rep)
+{
+  if (!rep || rep->GetTimescale() == 0)
+    return 0;
+
+  return static_cast<double>(segment.m_duration) / rep->GetTimescale();
+}
+
+// Estimate the segment size from the byte range when available, otherwise from the bandwidth
+uint64_t EstimateSegmentSize(const PLAYLIST::CSegment& segment, const PLAYLIST::CRepresentation* rep)
+{
+  if (segment.HasByteRange() && segment.range_end_ != PLAYLIST::NO_VALUE &&
+      segment.range_end_ >= segment.range_begin_)
+  {
+    return segment.range_end_ - segment.range_begin_ + 1;
+  }
+
+  return static_cast<uint64_t>(GetSegmentDurationSecs(segment, rep) * rep->GetBandwidth() / 8);
+}
+
+// Get the nominal segment duration of a representation
+double GetRepSegmentDurationSecs(const PLAYLIST::CRepresentation* rep)
+{
+  if (rep->HasSegmentTemplate() && rep->GetSegmentTemplate()->GetTimescale() > 0 &&
+      rep->GetSegmentTemplate()->GetDuration() > 0)
+  {
+    return static_cast<double>(rep->GetSegmentTemplate()->GetDuration()) /
+           rep->GetSegmentTemplate()->GetTimescale();
+  }
+
+  const PLAYLIST::CSegment* segment = rep->SegmentTimeline().Get(0);
+  return segment ? GetSegmentDurationSecs(*segment, rep) : 0;
+}
+} // unnamed namespace
+
 uint32_t AdaptiveStream::globalClsId = 0;
 
 AdaptiveStream::AdaptiveStream(AdaptiveTree& tree,
@@ -92,9 +146,15 @@ void adaptive::AdaptiveStream::DeallocateSegmentBuffers()
 {
   for (auto itSegBuf = segment_buffers_.begin(); itSegBuf != segment_buffers_.end();)
   {
+    // The segment buffer referenced by the view is detached, so m_viewBuffer never dangle
+    ClearSegmentBuffer(**itSegBuf);
     delete *itSegBuf;
     itSegBuf = segment_buffers_.erase(itSegBuf);
   }
+
+  std::lock_guard<std::mutex> lckview(m_viewMutex);
+  ReleaseViewData();
+  m_viewBuffer = nullptr;
 }
 
 bool adaptive::AdaptiveStream::Download(const DownloadInfo& downloadInfo,
@@ -125,6 +185,31 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
   std::map<std::string, std::string> headers = m_streamHeaders;
   headers.insert(downloadInfo.m_addHeaders.begin(), downloadInfo.m_addHeaders.end());
 
+  SEGMENTBUFFER* segBuffer = downloadInfo.m_segmentBuffer;
+  // The next segment buffers to fill, when contiguous byte ranges are coalesced
+  std::deque<SEGMENTBUFFER*> nextBuffers;
+
+  if (!downloadData && !downloadInfo.m_coalescedBuffers.empty())
+  {
+    nextBuffers.assign(downloadInfo.m_coalescedBuffers.begin(),
+                       downloadInfo.m_coalescedBuffers.end());
+
+    // When the download is retried, skip the segment buffers already completed
+    // and resume the partially downloaded one, since it could be already in reading
+    for (size_t i = 0; i < downloadInfo.m_completedBuffers; ++i)
+    {
+      segBuffer = nextBuffers.front();
+      nextBuffers.pop_front();
+    }
+
+    const uint64_t rangeBegin = segBuffer->segment.range_begin_ + segBuffer->data_size;
+    const uint64_t rangeEnd =
+        nextBuffers.empty() ? segBuffer->segment.range_end_ : nextBuffers.back()->segment.range_end_;
+
+    headers["Range"] = StringUtils::Format("bytes=%llu-%llu", rangeBegin + m_segmentFileOffset,
+                                           rangeEnd + m_segmentFileOffset);
+  }
+
   // Append stream parameters, only if not already provided
   if (url.find('?') == std::string::npos)
     URL::AppendParameters(url, m_streamParams);
@@ -132,6 +217,7 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
   CURL::CUrl curl{url};
   curl.AddHeaders(headers);
 
+  const auto requestTime = std::chrono::steady_clock::now();
   int statusCode = curl.Open(true);
 
   if (statusCode == -1)
@@ -141,23 +227,104 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
              url.c_str());
   else // Start the download
   {
+    CHOOSER::IRepresentationChooser* reprChooser = tree_.GetRepChooser();
+    const auto transferStartTime = std::chrono::steady_clock::now();
+    auto abandonCheckTime = transferStartTime;
+    reprChooser->AddDownloadTimeToFirstByte(
+        std::chrono::duration<double>(transferStartTime - requestTime).count());
+    // The data of the concurrent downloads are added together to estimate the throughput
+    reprChooser->StartDownloadTransfer();
+
+    // A single segment download can be abandoned when too slow, to switch to a lower quality
+    const uint64_t contentLength = curl.GetContentLength();
+    const bool canAbandon = !downloadData && nextBuffers.empty() && contentLength > 0 &&
+                            reprChooser->IsDownloadAbandonAllowed() &&
+                            current_adp_->GetRepresentations().size() > 1;
+
     CURL::ReadStatus downloadStatus = CURL::ReadStatus::CHUNK_READ;
     bool isChunked = curl.IsChunked();
 
+    // When the data dont need to be processed by the tree (e.g. decrypted) the chunks
+    // are read directly into the segment buffer, otherwise an intermediate buffer is needed
+    const bool isProcessingRequired =
+        !downloadData && tree_.IsDataProcessingRequired(segBuffer->segment.pssh_set_);
+    std::vector<uint8_t> bufferData;
+    if (isProcessingRequired)
+      bufferData.resize(CURL::BUFFER_SIZE_32);
+
+    if (downloadData)
+      downloadData->reserve(static_cast<size_t>(curl.GetContentLength()));
+    else
+      ReserveSegmentBuffer(curl, *segBuffer);
+
     while (downloadStatus == CURL::ReadStatus::CHUNK_READ)
     {
-      std::vector<uint8_t> bufferData(CURL::BUFFER_SIZE_32);
       size_t bytesRead{0};
 
-      downloadStatus = curl.ReadChunk(bufferData.data(), CURL::BUFFER_SIZE_32, bytesRead);
-
-      if (downloadStatus == CURL::ReadStatus::CHUNK_READ)
+      if (downloadData) // Write the data in to the vector
       {
-        if (downloadData) // Write the data in to the string
+        const size_t dataSize = downloadData->size();
+        downloadData->resize(dataSize + CURL::BUFFER_SIZE_32);
+        downloadStatus =
+            curl.ReadChunk(downloadData->data() + dataSize, CURL::BUFFER_SIZE_32, bytesRead);
+        downloadData->resize(dataSize + bytesRead);
+      }
+      else if (!isProcessingRequired) // Write the data in place to the segment buffer
+      {
+        size_t maxChunkSize = CURL::BUFFER_SIZE_32;
+        uint64_t segmentSize{0};
+
+        // With coalesced byte ranges, a segment buffer must be filled up to its range size only
+        if (!nextBuffers.empty())
+        {
+          segmentSize = segBuffer->segment.range_end_ - segBuffer->segment.range_begin_ + 1;
+          maxChunkSize = static_cast<size_t>(
+              std::min<uint64_t>(maxChunkSize, segmentSize - segBuffer->data_size));
+        }
+
+        downloadStatus = ReadChunkInPlace(curl, *segBuffer, maxChunkSize, bytesRead);
+        bool isSegmentCompleted{false};
+
+        if (downloadStatus == CURL::ReadStatus::CHUNK_READ)
         {
-          downloadData->insert(downloadData->end(), bufferData.begin(), bufferData.end());
+          // The status can be changed meantime e.g. video seek/stop
+          if (state_ == STOPPED)
+            break;
+
+          const size_t dataSize = segBuffer->data_size + bytesRead;
+
+          // Segment completed, the reader can switch to the next one while we fill it
+          if (!nextBuffers.empty() && dataSize >= segmentSize)
+          {
+            {
+              std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+              segBuffer->data_size = dataSize;
+              segBuffer->buffer.resize(dataSize);
+              segBuffer->is_downloading = false;
+              downloadInfo.m_completedBuffers++;
+            }
+            thread_data_->signal_rw_.notify_all();
+            isSegmentCompleted = true;
+          }
+          else
+          {
+            // Commit the chunk without locking, so it can be read
+            CommitSegmentData(*segBuffer, dataSize);
+          }
         }
-        else // Write the data to the segment buffer
+
+        if (isSegmentCompleted)
+        {
+          segBuffer = nextBuffers.front();
+          nextBuffers.pop_front();
+          ReserveSegmentBuffer(curl, *segBuffer);
+        }
+      }
+      else // Write the data to the segment buffer by processing it
+      {
+        downloadStatus = curl.ReadChunk(bufferData.data(), CURL::BUFFER_SIZE_32, bytesRead);
+
+        if (downloadStatus == CURL::ReadStatus::CHUNK_READ)
         {
           // We only set lastChunk to true in the case of non-chunked transfers, the
           // current structure does not allow for knowing the file has finished for
@@ -170,16 +337,50 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
             if (state_ == STOPPED)
               break;
 
-            std::vector<uint8_t>& segmentBuffer = downloadInfo.m_segmentBuffer->buffer;
+            std::vector<uint8_t>& segmentBuffer = segBuffer->buffer;
+            // The data are appended to the buffer, so the memory can be reallocated
+            CReallocGuard reallocGuard{*this};
+
+            // Grow the buffer with the pool, the processed data are never bigger than the chunk
+            if (m_segmentBufferPool)
+              m_segmentBufferPool->Acquire(segmentBuffer, segmentBuffer.size() + bytesRead);
 
-            tree_.OnDataArrived(downloadInfo.m_segmentBuffer->segment_number,
-                                downloadInfo.m_segmentBuffer->segment.pssh_set_, m_decrypterIv,
-                                bufferData.data(), bytesRead, segmentBuffer, segmentBuffer.size(),
-                                isLastChunk);
+            tree_.OnDataArrived(segBuffer->segment_number, segBuffer->segment.pssh_set_,
+                                segBuffer->decrypter_iv, bufferData.data(), bytesRead, segmentBuffer,
+                                segmentBuffer.size(), isLastChunk);
+            segBuffer->data_size = segmentBuffer.size();
           }
           thread_data_->signal_rw_.notify_all();
         }
       }
+
+      if (bytesRead > 0)
+        reprChooser->AddDownloadData(bytesRead);
+
+      if (canAbandon && downloadStatus == CURL::ReadStatus::CHUNK_READ)
+      {
+        const auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration<double>(now - abandonCheckTime).count() >=
+            ABANDON_CHECK_INTERVAL)
+        {
+          abandonCheckTime = now;
+          if (AbandonDownload(*segBuffer, curl.GetTotalByteRead(), contentLength,
+                              std::chrono::duration<double>(now - transferStartTime).count()))
+          {
+            reprChooser->EndDownloadTransfer();
+            downloadInfo.m_isAbandoned = true;
+            return false;
+          }
+        }
+      }
+    }
+    reprChooser->EndDownloadTransfer();
+
+    if (!downloadData && !isProcessingRequired)
+    {
+      // Release the unused tail space
+      std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+      segBuffer->buffer.resize(segBuffer->data_size);
     }
 
     if (downloadStatus == CURL::ReadStatus::ERROR)
@@ -202,21 +403,128 @@ bool adaptive::AdaptiveStream::DownloadImpl(const DownloadInfo& downloadInfo,
       size_t totalBytesRead = curl.GetTotalByteRead();
       double downloadSpeed = curl.GetDownloadSpeed();
 
-      // Set current download speed to repr. chooser (to update average).
-      // Small files are usually subtitles and their download speed are inaccurate
-      // by causing side effects in the average bandwidth so we ignore them.
-      static const size_t minSize{512 * 1024}; // 512 Kbyte
-      if (totalBytesRead > minSize)
-        tree_.GetRepChooser()->SetDownloadSpeed(downloadSpeed);
-
-      LOG::Log(LOGDEBUG, "[AS-%u] Download finished: %s (downloaded %zu byte, speed %0.2lf byte/s)",
-               clsId, url.c_str(), totalBytesRead, downloadSpeed);
+      LOG::Log(LOGDEBUG,
+               "[AS-%u] Download finished: %s (downloaded %zu byte, speed %0.2lf byte/s, "
+               "queue depth %zu)",
+               clsId, url.c_str(), totalBytesRead, downloadSpeed, GetDownloadQueueDepth());
       return true;
     }
   }
   return false;
 }
 
+void AdaptiveStream::ReserveSegmentBuffer(CURL::CUrl& curl, SEGMENTBUFFER& segBuffer)
+{
+  const CSegment& segment = segBuffer.segment;
+  uint64_t segmentSize{0};
+
+  if (segment.HasByteRange() && segment.range_end_ != NO_VALUE)
+    segmentSize = segment.range_end_ - segment.range_begin_ + 1;
+  else
+    segmentSize = curl.GetContentLength();
+
+  if (segmentSize == 0)
+    return;
+
+  // One more byte allow to read the EOF without reallocate the buffer
+  const size_t capacity = static_cast<size_t>(segmentSize) + 1;
+
+  // The capacity of the buffer is kept when the segment buffer is recycled,
+  // so the reallocation happens only when a bigger segment is downloaded
+  if (segBuffer.buffer.capacity() < capacity)
+  {
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    CReallocGuard reallocGuard{*this};
+    if (m_segmentBufferPool)
+      m_segmentBufferPool->Acquire(segBuffer.buffer, capacity);
+    else
+      segBuffer.buffer.reserve(capacity);
+  }
+}
+
+AdaptiveStream::CReallocGuard::CReallocGuard(AdaptiveStream& stream) : m_stream{stream}
+{
+  // The flag is set before check if the reader is copying, and the reader do the opposite,
+  // so at least one of the two always see the flag of the other
+  m_stream.m_isBufferReallocating = true;
+  while (m_stream.m_isReaderCopying)
+    std::this_thread::yield();
+}
+
+AdaptiveStream::CReallocGuard::~CReallocGuard()
+{
+  m_stream.m_isBufferReallocating = false;
+}
+
+void AdaptiveStream::CommitSegmentData(SEGMENTBUFFER& segBuffer, size_t dataSize)
+{
+  segBuffer.data_size = dataSize;
+
+  // The reader set the waiting flag before check the committed length with the lock held,
+  // so the lock here ensure that the reader is already waiting when it is notified
+  if (m_isReaderWaiting)
+  {
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    thread_data_->signal_rw_.notify_all();
+  }
+}
+
+void AdaptiveStream::ClearSegmentBuffer(SEGMENTBUFFER& segBuffer)
+{
+  {
+    std::lock_guard<std::mutex> lckview(m_viewMutex);
+    if (&segBuffer == m_viewBuffer)
+    {
+      // The data are referenced by a view, keep the memory alive by detaching it
+      ReleaseViewData();
+      if (m_segmentBufferPool)
+        m_segmentBufferPool->Transfer(segBuffer.buffer, m_viewData);
+      else
+        m_viewData.swap(segBuffer.buffer);
+      m_viewBuffer = nullptr;
+      segBuffer.data_size = 0;
+      return;
+    }
+  }
+
+  if (m_segmentBufferPool)
+    m_segmentBufferPool->Release(segBuffer.buffer);
+  else
+    segBuffer.buffer.clear();
+
+  segBuffer.data_size = 0;
+}
+
+CURL::ReadStatus AdaptiveStream::ReadChunkInPlace(CURL::CUrl& curl,
+                                                  SEGMENTBUFFER& segBuffer,
+                                                  size_t maxChunkSize,
+                                                  size_t& bytesRead)
+{
+  size_t chunkSize = maxChunkSize;
+
+  // Read within the reserved capacity, when possible, to avoid reallocations
+  const size_t freeCapacity = segBuffer.buffer.capacity() - segBuffer.data_size;
+  if (freeCapacity > 0 && freeCapacity < chunkSize)
+    chunkSize = freeCapacity;
+
+  if (segBuffer.buffer.size() < segBuffer.data_size + chunkSize)
+  {
+    // The reader can access to the buffer data at same time, so the tail space where to write
+    // the chunk must be allocated with the lock, since it may cause the memory reallocation.
+    // The buffer is extended up to its capacity, so the next chunks dont need the lock.
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    CReallocGuard reallocGuard{*this};
+
+    if (m_segmentBufferPool)
+      m_segmentBufferPool->Acquire(segBuffer.buffer, segBuffer.data_size + chunkSize);
+    segBuffer.buffer.resize(
+        std::max(segBuffer.data_size + chunkSize, segBuffer.buffer.capacity()));
+  }
+  // The data beyond data_size is never accessed by the reader, then the chunk can be written
+  // without holding the lock, and only the worker thread can resize the buffer meantime.
+  return curl.ReadChunk(segBuffer.buffer.data() + segBuffer.data_size, chunkSize, bytesRead);
+}
+
 bool AdaptiveStream::PrepareNextDownload(DownloadInfo& downloadInfo)
 {
   // We assume, that we find the next segment to load in the next valid_segment_buffers_
@@ -227,10 +535,65 @@ bool AdaptiveStream::PrepareNextDownload(DownloadInfo& downloadInfo)
   ++valid_segment_buffers_;
 
   // Clear existing data
-  segBuffer->buffer.clear();
+  ClearSegmentBuffer(*segBuffer);
   downloadInfo.m_segmentBuffer = segBuffer;
 
-  return PrepareDownload(segBuffer->rep, segBuffer->segment, downloadInfo);
+  if (!PrepareDownload(segBuffer->rep, segBuffer->segment, downloadInfo))
+    return false;
+
+  CoalesceNextDownloads(downloadInfo);
+  return true;
+}
+
+void AdaptiveStream::CoalesceNextDownloads(DownloadInfo& downloadInfo)
+{
+  // Limit the size of a coalesced request, to not delay too much the download
+  // completion of the last segments and so the download speed updates
+  static const uint64_t maxCoalescedSize{8 * 1024 * 1024};
+
+  const SEGMENTBUFFER* prevBuffer = downloadInfo.m_segmentBuffer;
+  const CRepresentation* rep = prevBuffer->rep;
+
+  // Only the segments of SegmentBase representations (sidx) that dont need to be processed
+  // by the tree are contiguous parts of the same file
+  if (!rep->HasSegmentBase() || prevBuffer->segment.IsInitialization() ||
+      !prevBuffer->segment.HasByteRange() || prevBuffer->segment.range_end_ == NO_VALUE ||
+      tree_.IsDataProcessingRequired(prevBuffer->segment.pssh_set_))
+  {
+    return;
+  }
+
+  uint64_t coalescedSize = prevBuffer->segment.range_end_ - prevBuffer->segment.range_begin_ + 1;
+
+  while (valid_segment_buffers_ < available_segment_buffers_)
+  {
+    SEGMENTBUFFER* segBuffer = segment_buffers_[valid_segment_buffers_];
+    const CSegment& seg = segBuffer->segment;
+
+    if (segBuffer->rep != rep || seg.IsInitialization() || !seg.HasByteRange() ||
+        seg.range_end_ == NO_VALUE || seg.url != prevBuffer->segment.url ||
+        seg.pssh_set_ != prevBuffer->segment.pssh_set_ ||
+        seg.range_begin_ != prevBuffer->segment.range_end_ + 1)
+    {
+      break;
+    }
+
+    coalescedSize += seg.range_end_ - seg.range_begin_ + 1;
+    if (coalescedSize > maxCoalescedSize)
+      break;
+
+    ++valid_segment_buffers_;
+    ClearSegmentBuffer(*segBuffer);
+    segBuffer->is_downloading = true;
+    downloadInfo.m_coalescedBuffers.emplace_back(segBuffer);
+    prevBuffer = segBuffer;
+  }
+
+  if (!downloadInfo.m_coalescedBuffers.empty())
+  {
+    LOG::Log(LOGDEBUG, "[AS-%u] Coalesced %zu segments in a single request", clsId,
+             downloadInfo.m_coalescedBuffers.size() + 1);
+  }
 }
 
 bool AdaptiveStream::PrepareDownload(const PLAYLIST::CRepresentation* rep,
@@ -241,7 +604,7 @@ bool AdaptiveStream::PrepareDownload(const PLAYLIST::CRepresentation* rep,
 
   if (rep->HasSegmentTemplate())
   {
-    auto segTpl = rep->GetSegmentTemplate();
+    const auto& segTpl = rep->GetSegmentTemplate();
 
     if (seg.IsInitialization()) // Templated initialization segment
     {
@@ -307,7 +670,7 @@ void AdaptiveStream::ResetActiveBuffer(bool oneValid)
   valid_segment_buffers_ = oneValid ? 1 : 0;
   available_segment_buffers_ = valid_segment_buffers_;
   absolute_position_ = 0;
-  segment_buffers_[0]->buffer.clear();
+  ClearSegmentBuffer(*segment_buffers_[0]);
   segment_read_pos_ = 0;
 }
 
@@ -315,16 +678,23 @@ bool AdaptiveStream::StopWorker(STATE state)
 {
   // stop downloading chunks
   state_ = state;
+  // wake up the workers waiting for a download slot, to allow them to check the new state
+  if (m_downloadScheduler)
+    m_downloadScheduler->Interrupt();
   // wait until last reading operation stopped
   // make sure download section in worker thread is done.
   std::unique_lock<std::mutex> lckrw(thread_data_->mutex_rw_);
-  while (worker_processing_)
+  // wake up the workers waiting to retry a failed download
+  thread_data_->signal_rw_.notify_all();
+  // The downloads waiting to retry dont change the segment buffers until the worker runs
+  // again, so they are waited only to stop
+  while (active_downloads_ > (state == PAUSED ? m_retryWaits : 0))
   {
     // While we are waiting the state of worker may be changed
     thread_data_->signal_rw_.wait(lckrw);
   }
 
-  // Now if the state set is PAUSED/STOPPED the worker thread should keep the lock to mutex_dl_
+  // Now if the state set is PAUSED/STOPPED the worker threads should keep the lock to mutex_dl_
   // and wait for a signal to condition varibale "signal_dl_.wait",
   // if state will be not changed to RUNNING next downloads will be not performed.
 
@@ -339,16 +709,21 @@ void adaptive::AdaptiveStream::WaitWorker()
   // If the worker is in PAUSED/STOPPED state
   // we wait here until condition variable "signal_dl_.wait" is executed,
   // after that the worker will be waiting for a signal to unlock "signal_dl_.wait" (blocking thread)
-  std::lock_guard<std::mutex> lckdl(thread_data_->mutex_dl_);
-  // Make sure that worker continue the loop (avoid signal_dl_.wait block again the thread)
-  // and allow new downloads
-  state_ = RUNNING;
+  {
+    std::lock_guard<std::mutex> lckdl(thread_data_->mutex_dl_);
+    // Make sure that worker continue the loop (avoid signal_dl_.wait block again the thread)
+    // and allow new downloads
+    state_ = RUNNING;
+  }
+  // Wake up the workers paused while waiting to retry a failed download, the lock ensures
+  // that they are waiting or will see the new state
+  std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+  thread_data_->signal_rw_.notify_all();
 }
 
 void AdaptiveStream::worker()
 {
   std::unique_lock<std::mutex> lckdl(thread_data_->mutex_dl_);
-  worker_processing_ = false;
   thread_data_->signal_dl_.notify_one();
   do
   {
@@ -360,23 +735,23 @@ void AdaptiveStream::worker()
 
     if (!thread_data_->thread_stop_)
     {
-      worker_processing_ = true;
-
       DownloadInfo downloadInfo;
       if (!PrepareNextDownload(downloadInfo))
-      {
-        worker_processing_ = false;
         continue;
-      }
 
-      // tell the main thread that we have processed prepare_download;
-      thread_data_->signal_dl_.notify_one();
+      SEGMENTBUFFER* segBuffer = downloadInfo.m_segmentBuffer;
+      segBuffer->is_downloading = true;
+      active_downloads_++;
+      const CDownloadScheduler::Priority priority = GetDownloadPriority(segBuffer);
+
+      // tell the main thread that we have processed prepare_download,
+      // and wake up other workers if there are more segments queued for download
+      thread_data_->signal_dl_.notify_all();
       lckdl.unlock();
 
-      //! @todo: for live content we should calculate max attempts and sleep timing
+      //! @todo: for live content we should calculate max attempts
       //! based on segment duration / playlist updates timing
       size_t maxAttempts = tree_.IsLive() ? 10 : 6;
-      std::chrono::milliseconds msSleep = tree_.IsLive() ? 1000ms : 500ms;
 
       //! @todo: Some streaming software offers subtitle tracks with missing fragments, usually live tv
       //! When a programme is broadcasted that has subtitles, subtitles fragments are offered,
@@ -391,36 +766,340 @@ void AdaptiveStream::worker()
       // then we try downloading the segment more times before aborting playback
       while (state_ != STOPPED)
       {
+        // Wait for a free download slot shared with the other streams of the session
+        if (m_downloadScheduler &&
+            !m_downloadScheduler->Acquire(
+                clsId, priority, segBuffer,
+                [this] { return thread_data_->thread_stop_ || state_ == STOPPED; }))
+        {
+          break;
+        }
+
         isSegmentDownloaded = DownloadSegment(downloadInfo);
-        if (isSegmentDownloaded || downloadAttempts == maxAttempts || state_ == STOPPED)
+
+        // The slot is released also while waiting to retry, to not block the other streams
+        if (m_downloadScheduler)
+          m_downloadScheduler->Release(clsId);
+
+        if (isSegmentDownloaded || state_ == STOPPED)
+          break;
+
+        // The segment buffer has been switched to a lower representation, download it again
+        if (downloadInfo.m_isAbandoned)
+        {
+          DownloadInfo abandonedInfo;
+          abandonedInfo.m_segmentBuffer = segBuffer;
+
+          lckdl.lock();
+          const bool isPrepared = PrepareDownload(segBuffer->rep, segBuffer->segment, abandonedInfo);
+          lckdl.unlock();
+
+          if (!isPrepared)
+            break;
+
+          downloadInfo = std::move(abandonedInfo);
+          continue;
+        }
+
+        if (downloadAttempts == maxAttempts)
+        {
+          m_downloadAborts++;
+          LOG::Log(LOGERROR, "[AS-%u] Segment download failed after %zu attempts (aborts: %u)",
+                   clsId, downloadAttempts, m_downloadAborts.load());
           break;
+        }
 
-        //! @todo: forcing thread sleep block the thread also while the state_ / thread_stop_ change values
-        //! we have to interrupt the sleep when it happens
-        std::this_thread::sleep_for(msSleep);
+        const std::chrono::milliseconds retryDelay = GetRetryDelay(*segBuffer, downloadAttempts);
         downloadAttempts++;
-        LOG::Log(LOGWARNING, "[AS-%u] Segment download failed, attempt %zu...", clsId, downloadAttempts);
-      }
+        m_downloadRetries++;
+        LOG::Log(LOGWARNING, "[AS-%u] Segment download failed, attempt %zu in %lld ms...", clsId,
+                 downloadAttempts, static_cast<long long>(retryDelay.count()));
 
-      lckdl.lock();
+        if (!WaitRetryDelay(retryDelay))
+          break;
+      }
 
-      if (!isSegmentDownloaded)
       {
         std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
         // Download cancelled or cannot download the file
-        state_ = STOPPED;
+        if (!isSegmentDownloaded)
+          state_ = STOPPED;
+
+        // The coalesced segment buffers already completed could be in use by other downloads
+        if (downloadInfo.m_completedBuffers == 0)
+          segBuffer->is_downloading = false;
+
+        for (size_t i = std::max<size_t>(downloadInfo.m_completedBuffers, 1);
+             i <= downloadInfo.m_coalescedBuffers.size(); ++i)
+        {
+          downloadInfo.m_coalescedBuffers[i - 1]->is_downloading = false;
+        }
       }
 
+      lckdl.lock();
+
       // Signal finished download
-      worker_processing_ = false;
+      active_downloads_--;
       thread_data_->signal_rw_.notify_all();
     }
   } while (!thread_data_->thread_stop_);
 
-  worker_processing_ = false;
   lckdl.unlock();
 }
 
+CHOOSER::BufferStatus AdaptiveStream::GetBufferStatus() const
+{
+  CHOOSER::BufferStatus status;
+
+  const SEGMENTBUFFER* firstBuffer = segment_buffers_.empty() ? nullptr : segment_buffers_[0];
+  if (!firstBuffer || !firstBuffer->rep || firstBuffer->rep->GetTimescale() == 0 ||
+      firstBuffer->segment.m_duration == 0)
+  {
+    return status;
+  }
+
+  // Only the media of the consecutive segments already downloaded can be played,
+  // the buffers still queued or in download are not counted
+  for (size_t i = 0; i < valid_segment_buffers_; ++i)
+  {
+    const SEGMENTBUFFER* segBuffer = segment_buffers_[i];
+    if (segBuffer->is_downloading || segBuffer->data_size == 0)
+      break;
+
+    const double durationSecs = GetSegmentDurationSecs(segBuffer->segment, segBuffer->rep);
+
+    // The first segment buffer is in reading by the demuxer, count only the part left to read
+    if (i == 0)
+      status.m_levelSecs += durationSecs * (1.0 - static_cast<double>(segment_read_pos_) /
+                                                      segBuffer->data_size);
+    else
+      status.m_levelSecs += durationSecs;
+  }
+
+  if (m_bufferMaxSecs > 0)
+    status.m_maxLevelSecs = m_bufferMaxSecs;
+  else
+    status.m_maxLevelSecs = static_cast<double>(firstBuffer->segment.m_duration) /
+                            firstBuffer->rep->GetTimescale() * max_buffer_length_;
+
+  return status;
+}
+
+bool AdaptiveStream::IsSegmentAdmitted(size_t bufferPos,
+                                       double bufferedSecs,
+                                       uint64_t bufferedBytes,
+                                       double segmentSecs,
+                                       uint64_t segmentBytes) const
+{
+  if (bufferPos < MIN_ADMITTED_SEGMENTS)
+    return true;
+
+  // Without the segment duration the buffer is limited by the number of segment buffers only
+  if (segmentSecs > 0)
+  {
+    // The assured buffer is always filled, also when the memory budget is exhausted,
+    // otherwise the playback could stall waiting for the other streams to free memory
+    if (bufferedSecs < m_bufferAssuredSecs)
+      return true;
+
+    if (m_bufferMaxSecs > 0 && bufferedSecs + segmentSecs > m_bufferMaxSecs)
+      return false;
+  }
+
+  return !m_bufferBudget || m_bufferBudget->IsAvailable(clsId, bufferedBytes + segmentBytes);
+}
+
+bool AdaptiveStream::AbandonDownload(SEGMENTBUFFER& segBuffer,
+                                     uint64_t bytesRead,
+                                     uint64_t bytesTotal,
+                                     double transferSecs)
+{
+  if (bytesRead == 0 || transferSecs < ABANDON_MIN_TRANSFER_DURATION ||
+      bytesRead >= bytesTotal * ABANDON_MAX_PROGRESS || segBuffer.segment.IsInitialization())
+  {
+    return false;
+  }
+
+  const double rate = bytesRead / transferSecs; // byte/s
+  const double remainingSecs = (bytesTotal - bytesRead) / rate;
+
+  std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+  std::lock_guard<std::mutex> lckdl(thread_data_->mutex_dl_);
+
+  // The first segment buffer can be already in reading by the demux reader, so it cannot be switched
+  if (state_ != RUNNING || available_segment_buffers_ < 2)
+    return false;
+
+  const auto itBegin = segment_buffers_.begin();
+  const auto itEnd = segment_buffers_.begin() + available_segment_buffers_;
+  const auto itSegBuffer = std::find(itBegin + 1, itEnd, &segBuffer);
+  if (itSegBuffer == itEnd)
+    return false;
+
+  CRepresentation* currentRep = segBuffer.rep;
+  const uint64_t segPos = segBuffer.segment_number - currentRep->GetStartNumber();
+
+  // As in ensureSegment, dont change representation on the last segment of a period
+  if (currentRep->GetBandwidth() == 0 || segPos + 1 >= currentRep->SegmentTimeline().GetSize())
+    return false;
+
+  // The seconds of media that can be played before the segment is needed
+  double bufferLeftSecs{0};
+  for (auto it = itBegin; it != itSegBuffer; ++it)
+  {
+    const SEGMENTBUFFER* prevBuffer = *it;
+    const double durationSecs = GetSegmentDurationSecs(prevBuffer->segment, prevBuffer->rep);
+    if (durationSecs == 0)
+      return false;
+
+    if (it == itBegin && !prevBuffer->is_downloading && prevBuffer->data_size > 0)
+      bufferLeftSecs += durationSecs * (1.0 - static_cast<double>(segment_read_pos_) /
+                                                  prevBuffer->data_size);
+    else
+      bufferLeftSecs += durationSecs;
+  }
+
+  if (remainingSecs <= bufferLeftSecs)
+    return false;
+
+  // Find the highest representation that can be downloaded in time, otherwise the fastest one,
+  // the segment size is estimated from the ratio of the bandwidths
+  CRepresentation* lowerRep{nullptr};
+  double lowerDownloadSecs{0};
+
+  for (auto& rep : current_adp_->GetRepresentations())
+  {
+    if (rep->GetBandwidth() >= currentRep->GetBandwidth() || rep->SegmentTimeline().IsEmpty() ||
+        segBuffer.segment_number < rep->GetStartNumber() ||
+        !rep->get_segment(static_cast<size_t>(segBuffer.segment_number - rep->GetStartNumber())))
+    {
+      continue;
+    }
+
+    const double downloadSecs = static_cast<double>(bytesTotal) * rep->GetBandwidth() /
+                                currentRep->GetBandwidth() / rate;
+    const bool isInTime = downloadSecs <= bufferLeftSecs;
+    const bool isLowerInTime = lowerRep && lowerDownloadSecs <= bufferLeftSecs;
+
+    if (!lowerRep ||
+        (isInTime && (!isLowerInTime || rep->GetBandwidth() > lowerRep->GetBandwidth())) ||
+        (!isInTime && !isLowerInTime && downloadSecs < lowerDownloadSecs))
+    {
+      lowerRep = rep.get();
+      lowerDownloadSecs = downloadSecs;
+    }
+  }
+
+  // Nothing to gain by restarting the download
+  if (!lowerRep || lowerDownloadSecs >= remainingSecs)
+    return false;
+
+  LOG::Log(LOGDEBUG,
+           "[AS-%u] Download abandoned, projected to finish in %0.2lf secs with %0.2lf secs of "
+           "buffer left, switch representation from ID %s to ID %s",
+           clsId, remainingSecs, bufferLeftSecs, currentRep->GetId().data(),
+           lowerRep->GetId().data());
+
+  // Switch the abandoned segment buffer, and the following ones still queued
+  // with the same representation, so they are not downloaded at high quality
+  for (auto it = itSegBuffer; it != itEnd; ++it)
+  {
+    SEGMENTBUFFER* switchBuffer = *it;
+    const size_t bufferPos = static_cast<size_t>(it - itBegin);
+
+    if (switchBuffer != &segBuffer &&
+        (bufferPos < valid_segment_buffers_ || switchBuffer->rep != currentRep))
+    {
+      continue;
+    }
+
+    const CSegment* lowerSegment = lowerRep->get_segment(
+        static_cast<size_t>(switchBuffer->segment_number - lowerRep->GetStartNumber()));
+    if (!lowerSegment)
+      break;
+
+    switchBuffer->segment = *lowerSegment;
+    switchBuffer->rep = lowerRep;
+    ClearSegmentBuffer(*switchBuffer);
+  }
+
+  m_downloadAbandons++;
+  return true;
+}
+
+std::chrono::milliseconds AdaptiveStream::GetRetryDelay(const SEGMENTBUFFER& segBuffer,
+                                                        size_t attempt) const
+{
+  // Without the segment duration fallback to a fixed timing
+  uint64_t segDurationMs = tree_.IsLive() ? 4000 : 2000;
+
+  if (segBuffer.rep && segBuffer.rep->GetTimescale() > 0 && segBuffer.segment.m_duration > 0)
+    segDurationMs = segBuffer.segment.m_duration * 1000 / segBuffer.rep->GetTimescale();
+
+  // The first retry is done quickly, then the delay grows exponentially
+  // but never over the segment duration, to not exhaust the buffer while waiting
+  const uint64_t baseDelayMs = std::clamp<uint64_t>(segDurationMs / 8, 100, 1000);
+  const uint64_t maxDelayMs = std::clamp<uint64_t>(segDurationMs, baseDelayMs, 8000);
+  const uint64_t delayMs =
+      std::min(baseDelayMs << std::min<size_t>(attempt - 1, 16), maxDelayMs);
+
+  // Add the jitter, to avoid that the workers of all streams retry at same time
+  static thread_local std::mt19937 randomGen{std::random_device{}()};
+  std::uniform_int_distribution<uint64_t> distribution(delayMs / 2, delayMs);
+
+  return std::chrono::milliseconds(distribution(randomGen));
+}
+
+bool AdaptiveStream::WaitRetryDelay(std::chrono::milliseconds delay)
+{
+  const auto retryTime = std::chrono::steady_clock::now() + delay;
+  std::unique_lock<std::mutex> lckrw(thread_data_->mutex_rw_);
+
+  // Let StopWorker(PAUSED) return while we wait, it can be already waiting for this download
+  m_retryWaits++;
+  thread_data_->signal_rw_.notify_all();
+
+  // The wait is interrupted when the worker is stopped e.g. on playback stop, a paused worker
+  // (e.g. on seek) waits to run again, then the download is retried when the delay is elapsed
+  while (state_ != STOPPED && !thread_data_->thread_stop_)
+  {
+    if (state_ != RUNNING)
+      thread_data_->signal_rw_.wait(lckrw);
+    else if (thread_data_->signal_rw_.wait_until(lckrw, retryTime) == std::cv_status::timeout &&
+             state_ == RUNNING)
+      break;
+  }
+
+  m_retryWaits--;
+  return state_ != STOPPED && !thread_data_->thread_stop_;
+}
+
+CDownloadScheduler::Priority AdaptiveStream::GetDownloadPriority(
+    const SEGMENTBUFFER* segBuffer) const
+{
+  // The first segment buffer is the one currently read by the demuxer
+  if (segBuffer == segment_buffers_[0])
+    return CDownloadScheduler::Priority::URGENT;
+
+  const StreamType streamType = current_adp_->GetStreamType();
+  if (m_isTimingStream || streamType == StreamType::VIDEO ||
+      streamType == StreamType::VIDEO_AUDIO)
+    return CDownloadScheduler::Priority::HIGH;
+
+  if (streamType == StreamType::AUDIO)
+    return CDownloadScheduler::Priority::NORMAL;
+
+  return CDownloadScheduler::Priority::LOW;
+}
+
+size_t AdaptiveStream::GetDownloadQueueDepth() const
+{
+  if (m_downloadScheduler)
+    return m_downloadScheduler->GetQueueDepth(clsId);
+
+  return active_downloads_;
+}
+
 int AdaptiveStream::SecondsSinceUpdate() const
 {
   const std::chrono::time_point<std::chrono::system_clock>& tPoint(
@@ -597,57 +1276,46 @@ bool AdaptiveStream::start_stream()
   if (!current_rep_)
     return false;
 
-  //! @todo: the assured_buffer_duration_ and max_buffer_duration_
-  //! isnt implemeted correctly and need to be reworked,
-  //! these properties are intended to determine the amount of buffer
-  //! customizable in seconds, but segments do not ensure that they always have
-  //! a fixed duration of 1 sec moreover these properties currently works for
-  //! the DASH manifest with "SegmentTemplate" tags defined only,
-  //! in all other type of manifest cases always fallback on hardcoded values
-  /*
-   * Adaptive/custom buffering code disabled
-   * currently cause a bad memory management especially for 4k content
-   * too much buffer length leads to filling the RAM and cause kodi to crash
-   * required to implement a way to determine the max length of the buffer 
-   * by taking in account also the device RAM
-   *
-  assured_buffer_length_ = current_rep_->assured_buffer_duration_;
-  max_buffer_length_ = current_rep_->max_buffer_duration_;
-
-  if (current_rep_->HasSegmentTemplate())
-  {
-    const auto& segTemplate = current_rep_->GetSegmentTemplate();
-    assured_buffer_length_ = std::ceil((assured_buffer_length_ * segTemplate->GetTimescale()) /
-                                       static_cast<float>(segTemplate->GetDuration()));
-    max_buffer_length_ = std::ceil((max_buffer_length_ * segTemplate->GetTimescale()) /
-                                   static_cast<float>(segTemplate->GetDuration()));
-  }
-  */
-  assured_buffer_length_  = assured_buffer_length_ <4 ? 4:assured_buffer_length_;//for incorrect settings input
-  if(max_buffer_length_<=assured_buffer_length_)//for incorrect settings input
-    max_buffer_length_=assured_buffer_length_+4u;
-
-  AllocateSegmentBuffers(max_buffer_length_);
-
   if (!thread_data_)
   {
     state_ = STOPPED;
     thread_data_ = new THREADDATA();
     std::unique_lock<std::mutex> lckdl(thread_data_->mutex_dl_);
-    thread_data_->Start(this);
+    thread_data_->Start(this, tree_.m_settings.m_segmentDownloadWorkers);
     // Wait until worker thread is waiting for input
     thread_data_->signal_dl_.wait(lckdl);
   }
 
+  bool isSegmentsGenerated{true};
   if (current_rep_->SegmentTimeline().IsEmpty() && !current_rep_->IsSubtitleFileStream())
   {
     // GenerateSidxSegments assumes mutex_dl locked
     std::lock_guard<std::mutex> lck(thread_data_->mutex_dl_);
-    if (!GenerateSidxSegments(current_rep_))
-    {
-      state_ = STOPPED;
-      return false;
-    }
+    isSegmentsGenerated = GenerateSidxSegments(current_rep_);
+  }
+
+  if (segment_buffers_.empty())
+  {
+    // The buffer is governed by the seconds of media and the memory budget of the session
+    // (see IsSegmentAdmitted), the number of segment buffers is only an upper bound
+    m_bufferAssuredSecs = current_rep_->assured_buffer_duration_;
+    m_bufferMaxSecs =
+        std::max(current_rep_->max_buffer_duration_, current_rep_->assured_buffer_duration_);
+
+    const double segDurationSecs = GetRepSegmentDurationSecs(current_rep_);
+    if (m_bufferMaxSecs > 0 && segDurationSecs > 0)
+      max_buffer_length_ = static_cast<uint32_t>(std::ceil(m_bufferMaxSecs / segDurationSecs));
+    else
+      max_buffer_length_ = DEFAULT_SEGMENT_BUFFERS;
+
+    max_buffer_length_ = std::clamp(max_buffer_length_, MIN_SEGMENT_BUFFERS, MAX_SEGMENT_BUFFERS);
+    AllocateSegmentBuffers(max_buffer_length_);
+  }
+
+  if (!isSegmentsGenerated)
+  {
+    state_ = STOPPED;
+    return false;
   }
 
   if (!current_rep_->current_segment_)
@@ -724,7 +1392,7 @@ bool AdaptiveStream::start_stream()
 
     segment_buffers_[0]->segment = *current_rep_->GetInitSegment();
     segment_buffers_[0]->rep = current_rep_;
-    segment_buffers_[0]->buffer.clear();
+    ClearSegmentBuffer(*segment_buffers_[0]);
     segment_read_pos_ = 0;
 
     // Force writing the data into segment_buffers_[0]
@@ -790,8 +1458,8 @@ bool AdaptiveStream::ensureSegment()
 
   // We an only switch to the next segment, if the current (== segment_buffers_[0]) is finished.
   // This is the case if we have more than 1 valid segments, or worker is not processing anymore.
-  if ((!worker_processing_ || valid_segment_buffers_ > 1) &&
-      segment_read_pos_ >= segment_buffers_[0]->buffer.size())
+  if (!segment_buffers_[0]->is_downloading &&
+      segment_read_pos_ >= segment_buffers_[0]->data_size)
   {
     // wait until worker is ready for new segment
     std::unique_lock<std::mutex> lck(thread_data_->mutex_dl_);
@@ -883,7 +1551,10 @@ bool AdaptiveStream::ensureSegment()
         if (isLastSegment)
           newRep = prevRep;
         else
+        {
+          tree_.GetRepChooser()->SetBufferStatus(current_adp_->GetStreamType(), GetBufferStatus());
           newRep = tree_.GetRepChooser()->GetNextRepresentation(current_adp_, prevRep);
+        }
       }
 
       // If the representation has been changed, segments may have to be generated (DASH)
@@ -903,12 +1574,33 @@ bool AdaptiveStream::ensureSegment()
       {
         nextsegmentPos = newRep->SegmentTimeline().GetSize() - available_segment_buffers_;
       }
+      // The seconds and the bytes of the segments already queued, for the admission control
+      double bufferedSecs{0};
+      uint64_t bufferedBytes{0};
+      for (size_t pos = 0; pos < available_segment_buffers_; ++pos)
+      {
+        const SEGMENTBUFFER* segBuffer = segment_buffers_[pos];
+        bufferedSecs += GetSegmentDurationSecs(segBuffer->segment, segBuffer->rep);
+        if (pos < valid_segment_buffers_ && !segBuffer->is_downloading)
+          bufferedBytes += segBuffer->data_size;
+        else
+          bufferedBytes += EstimateSegmentSize(segBuffer->segment, segBuffer->rep);
+      }
+
       for (size_t updPos(available_segment_buffers_); updPos < max_buffer_length_; ++updPos)
       {
         const CSegment* futureSegment = newRep->get_segment(nextsegmentPos + updPos);
 
         if (futureSegment)
         {
+          const double segmentSecs = GetSegmentDurationSecs(*futureSegment, newRep);
+          const uint64_t segmentBytes = EstimateSegmentSize(*futureSegment, newRep);
+
+          if (!IsSegmentAdmitted(updPos, bufferedSecs, bufferedBytes, segmentSecs, segmentBytes))
+            break;
+
+          bufferedSecs += segmentSecs;
+          bufferedBytes += segmentBytes;
           segment_buffers_[updPos]->segment = *futureSegment;
           segment_buffers_[updPos]->segment_number =
               newRep->GetStartNumber() + nextsegmentPos + updPos;
@@ -919,7 +1611,10 @@ bool AdaptiveStream::ensureSegment()
           break;
       }
 
-      thread_data_->signal_dl_.notify_one();
+      if (m_bufferBudget)
+        m_bufferBudget->SetUsage(clsId, bufferedBytes);
+
+      thread_data_->signal_dl_.notify_all();
       // Make sure that we have at least one segment filling
       // Otherwise we lead into a deadlock because first condition is false.
       if (!valid_segment_buffers_)
@@ -940,6 +1635,8 @@ bool AdaptiveStream::ensureSegment()
         current_rep_->SetIsWaitForSegment(true);
         LOG::LogF(LOGDEBUG, "[AS-%u] Begin WaitForSegment stream %s", clsId, current_rep_->GetId().data());
       }
+      // Set at each retry, it could have been cleared while the representation flag was changing
+      m_isWaitingForSegment = true;
       std::this_thread::sleep_for(std::chrono::milliseconds(100));
       return false;
     }
@@ -958,17 +1655,38 @@ uint32_t AdaptiveStream::read(void* buffer, uint32_t bytesToRead)
   if (state_ == STOPPED)
     return false;
 
+  // Most of the reads are small (e.g. atom headers, sample sizes) and the data
+  // are already committed, so they can be served without locking
+  if (bytesToRead > 0 && ReadCommittedData(buffer, bytesToRead))
+    return bytesToRead;
+
+  m_lockedReads++;
   std::unique_lock<std::mutex> lckrw(thread_data_->mutex_rw_);
 
   while (ensureSegment() && bytesToRead > 0)
   {
-    size_t avail = segment_buffers_[0]->buffer.size() - segment_read_pos_;
+    size_t avail = segment_buffers_[0]->data_size - segment_read_pos_;
+
+    // We are blocked waiting for the data, if the segment download is still queued
+    // it must be served before the prefetch of other segments
+    if (avail < bytesToRead && segment_buffers_[0]->is_downloading && m_downloadScheduler)
+      m_downloadScheduler->Promote(clsId, segment_buffers_[0]);
+
     // Wait until we have all data
-    while (avail < bytesToRead && worker_processing_)
+    while (avail < bytesToRead && segment_buffers_[0]->is_downloading)
     {
+      // The flag must be set before check again the committed length,
+      // so the worker cannot commit new data without wake up the reader
+      m_isReaderWaiting = true;
+      avail = segment_buffers_[0]->data_size - segment_read_pos_;
+      if (avail >= bytesToRead)
+        break;
+
+      m_readerWaits++;
       thread_data_->signal_rw_.wait(lckrw);
-      avail = segment_buffers_[0]->buffer.size() - segment_read_pos_;
+      avail = segment_buffers_[0]->data_size - segment_read_pos_;
     }
+    m_isReaderWaiting = false;
 
     if (avail > bytesToRead)
       avail = bytesToRead;
@@ -992,6 +1710,123 @@ uint32_t AdaptiveStream::read(void* buffer, uint32_t bytesToRead)
   return 0;
 }
 
+bool AdaptiveStream::ReadCommittedData(void* buffer, uint32_t bytesToRead)
+{
+  if (state_ != RUNNING)
+    return false;
+
+  // The flag is set before check the reallocation, see CReallocGuard
+  m_isReaderCopying = true;
+  bool isRead{false};
+
+  if (!m_isBufferReallocating)
+  {
+    const SEGMENTBUFFER* segBuffer = segment_buffers_[0];
+    const size_t readPos = segment_read_pos_;
+
+    if (readPos + bytesToRead <= segBuffer->data_size)
+    {
+      std::memcpy(buffer, segBuffer->buffer.data() + readPos, bytesToRead);
+      segment_read_pos_ = readPos + bytesToRead;
+      absolute_position_ += bytesToRead;
+      isRead = true;
+    }
+  }
+
+  m_isReaderCopying = false;
+
+  if (isRead)
+    m_lockFreeReads++;
+  return isRead;
+}
+
+bool AdaptiveStream::ReadView(uint32_t size, const uint8_t*& data)
+{
+  if (state_ != RUNNING || size == 0)
+    return false;
+
+  SEGMENTBUFFER* segBuffer = segment_buffers_[0];
+  const size_t readPos = segment_read_pos_;
+
+  // While the segment is downloading the memory can be reallocated, and a view
+  // cannot be used when the data must be read from the next segment
+  if (segBuffer->is_downloading || readPos + size > segBuffer->data_size)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lckview(m_viewMutex);
+    // The previous view is no longer used
+    ReleaseViewData();
+    m_viewBuffer = segBuffer;
+  }
+
+  data = segBuffer->buffer.data() + readPos;
+  segment_read_pos_ = readPos + size;
+  absolute_position_ += size;
+  m_viewReads++;
+  return true;
+}
+
+bool AdaptiveStream::HasSegmentDataToRead() const
+{
+  if (state_ != RUNNING || segment_buffers_.empty())
+    return false;
+
+  const SEGMENTBUFFER* segBuffer = segment_buffers_[0];
+  return segBuffer->is_downloading || segment_read_pos_ < segBuffer->data_size;
+}
+
+bool AdaptiveStream::PeekView(const uint8_t*& data, size_t& size)
+{
+  if (state_ != RUNNING)
+    return false;
+
+  SEGMENTBUFFER* segBuffer = segment_buffers_[0];
+  const size_t readPos = segment_read_pos_;
+
+  if (segBuffer->is_downloading || readPos >= segBuffer->data_size)
+    return false;
+
+  {
+    std::lock_guard<std::mutex> lckview(m_viewMutex);
+    ReleaseViewData();
+    m_viewBuffer = segBuffer;
+  }
+
+  data = segBuffer->buffer.data() + readPos;
+  size = segBuffer->data_size - readPos;
+  return true;
+}
+
+bool AdaptiveStream::SkipView(size_t size)
+{
+  if (state_ != RUNNING)
+    return false;
+
+  const SEGMENTBUFFER* segBuffer = segment_buffers_[0];
+  const size_t readPos = segment_read_pos_;
+
+  if (segBuffer->is_downloading || readPos + size > segBuffer->data_size)
+    return false;
+
+  segment_read_pos_ = readPos + size;
+  absolute_position_ += size;
+  m_viewReads++;
+  return true;
+}
+
+void AdaptiveStream::ReleaseViewData()
+{
+  // Mostly there are no detached data, avoid to lock the pool shared with the other streams
+  if (m_viewData.capacity() == 0)
+    return;
+
+  if (m_segmentBufferPool)
+    m_segmentBufferPool->Release(m_viewData);
+  else
+    std::vector<uint8_t>().swap(m_viewData);
+}
+
 bool AdaptiveStream::seek(uint64_t const pos)
 {
   if (state_ == STOPPED)
@@ -1004,12 +1839,21 @@ bool AdaptiveStream::seek(uint64_t const pos)
   {
     segment_read_pos_ = static_cast<size_t>(pos - (absolute_position_ - segment_read_pos_));
 
-    while (segment_read_pos_ > segment_buffers_[0]->buffer.size() && worker_processing_)
+    while (segment_read_pos_ > segment_buffers_[0]->data_size &&
+           segment_buffers_[0]->is_downloading)
+    {
+      m_isReaderWaiting = true;
+      if (segment_read_pos_ <= segment_buffers_[0]->data_size)
+        break;
+
+      m_readerWaits++;
       thread_data_->signal_rw_.wait(lckrw);
+    }
+    m_isReaderWaiting = false;
 
-    if (segment_read_pos_ > segment_buffers_[0]->buffer.size())
+    if (segment_read_pos_ > segment_buffers_[0]->data_size)
     {
-      segment_read_pos_ = segment_buffers_[0]->buffer.size();
+      segment_read_pos_ = segment_buffers_[0]->data_size.load();
       return false;
     }
     absolute_position_ = pos;
@@ -1018,6 +1862,56 @@ bool AdaptiveStream::seek(uint64_t const pos)
   return false;
 }
 
+size_t AdaptiveStream::WaitSegmentData(uint64_t pos, size_t size)
+{
+  if (state_ == STOPPED)
+    return 0;
+
+  std::unique_lock<std::mutex> lckrw(thread_data_->mutex_rw_);
+
+  const uint64_t segmentPos{absolute_position_ - segment_read_pos_};
+  if (state_ == STOPPED || pos < segmentPos)
+    return 0;
+
+  const size_t dataPos{static_cast<size_t>(pos - segmentPos)};
+
+  // As for read, a queued download of the current segment is served first
+  if (dataPos + size > segment_buffers_[0]->data_size && segment_buffers_[0]->is_downloading &&
+      m_downloadScheduler)
+    m_downloadScheduler->Promote(clsId, segment_buffers_[0]);
+
+  while (dataPos + size > segment_buffers_[0]->data_size && segment_buffers_[0]->is_downloading)
+  {
+    m_isReaderWaiting = true;
+    if (dataPos + size <= segment_buffers_[0]->data_size)
+      break;
+
+    m_readerWaits++;
+    thread_data_->signal_rw_.wait(lckrw);
+  }
+  m_isReaderWaiting = false;
+
+  const size_t dataSize{segment_buffers_[0]->data_size};
+  return dataPos < dataSize ? std::min(size, dataSize - dataPos) : 0;
+}
+
+AdaptiveStream::SEGMENTDATAID AdaptiveStream::GetSegmentDataId()
+{
+  SEGMENTDATAID id;
+  if (state_ == STOPPED)
+    return id;
+
+  std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+
+  if (state_ == STOPPED || segment_buffers_.empty())
+    return id;
+
+  id.m_rep = segment_buffers_[0]->rep;
+  id.m_segmentNumber = segment_buffers_[0]->segment_number;
+  id.m_startPos = absolute_position_ - segment_read_pos_;
+  return id;
+}
+
 bool AdaptiveStream::retrieveCurrentSegmentBufferSize(size_t& size)
 {
   if (state_ == STOPPED)
@@ -1026,7 +1920,7 @@ bool AdaptiveStream::retrieveCurrentSegmentBufferSize(size_t& size)
   if (!StopWorker(PAUSED))
     return false;
 
-  size = segment_buffers_[0]->buffer.size();
+  size = segment_buffers_[0]->data_size;
   WaitWorker();
   return true;
 }
@@ -1059,13 +1953,72 @@ uint64_t AdaptiveStream::getMaxTimeMs()
 
 void AdaptiveStream::ResetCurrentSegment(const PLAYLIST::CSegment* newSegment)
 {
+  size_t bufferPos{0};
+  size_t bufferCount{0};
+  {
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
+    std::lock_guard<std::mutex> lckdl(thread_data_->mutex_dl_);
+    // Downloads completed only after this check will be discarded by StopWorker
+    bufferCount = FindPrefetchedSegment(newSegment, bufferPos);
+  }
+
   StopWorker(STOPPED);
+
+  if (bufferCount > 0)
+  {
+    std::lock_guard<std::mutex> lckdl(thread_data_->mutex_dl_);
+
+    // Move the segment buffer preceding the new segment to the first position and mark it
+    // as consumed, so ensureSegment switches to the new segment as during the playback,
+    // the prefetched segments are kept, the following ones will be downloaded again
+    const size_t skipCount = bufferPos - 1;
+    std::rotate(segment_buffers_.begin(), segment_buffers_.begin() + skipCount,
+                segment_buffers_.begin() + available_segment_buffers_);
+    available_segment_buffers_ -= skipCount;
+    valid_segment_buffers_ = bufferPos + bufferCount - skipCount;
+    // The consumed segment starts at position 0, as after ResetActiveBuffer
+    segment_read_pos_ = segment_buffers_[0]->data_size.load();
+    absolute_position_ = segment_read_pos_;
+
+    LOG::Log(LOGDEBUG, "[AS-%u] Seek within the buffer, %zu prefetched segments kept", clsId,
+             bufferCount);
+  }
+
   WaitWorker();
   // EnsureSegment loads always the next segment, so go back 1
   current_rep_->current_segment_ =
     current_rep_->get_segment(current_rep_->get_segment_pos(newSegment) - 1);
-  // TODO: if new segment is already prefetched, don't ResetActiveBuffer;
-  ResetActiveBuffer(false);
+
+  if (bufferCount == 0)
+    ResetActiveBuffer(false);
+}
+
+size_t AdaptiveStream::FindPrefetchedSegment(const PLAYLIST::CSegment* segment,
+                                             size_t& bufferPos) const
+{
+  // A failed download could have left partial data
+  if (state_ == STOPPED || !segment || segment->IsInitialization())
+    return 0;
+
+  const uint64_t segNumber = current_rep_->getSegmentNumber(segment);
+
+  for (size_t i = 1; i < valid_segment_buffers_; ++i)
+  {
+    const SEGMENTBUFFER* segBuffer = segment_buffers_[i];
+    if (segBuffer->segment_number != segNumber || segBuffer->rep != current_rep_ ||
+        segBuffer->segment.IsInitialization())
+    {
+      continue;
+    }
+
+    size_t count{0};
+    while (i + count < valid_segment_buffers_ && !segment_buffers_[i + count]->is_downloading)
+      count++;
+
+    bufferPos = i;
+    return count;
+  }
+  return 0;
 }
 
 int adaptive::AdaptiveStream::GetTrackType() const
@@ -1114,14 +2067,9 @@ bool AdaptiveStream::seek_time(double seek_seconds, bool preceeding, bool& needR
 
   uint64_t sec_in_ts = static_cast<uint64_t>(seek_seconds * current_rep_->GetTimescale());
 
-  //Skip initialization
-  size_t choosen_seg{0};
-
-  while (choosen_seg < current_rep_->SegmentTimeline().GetSize() &&
-         sec_in_ts > current_rep_->get_segment(choosen_seg)->startPTS_)
-  {
-    ++choosen_seg;
-  }
+  // Find the first segment that starts at or after the seek time
+  size_t choosen_seg = current_rep_->SegmentTimeline().PartitionPoint(
+      [sec_in_ts](const CSegment& segment) { return segment.startPTS_ < sec_in_ts; });
 
   if (choosen_seg == current_rep_->SegmentTimeline().GetSize())
   {
@@ -1185,6 +2133,11 @@ bool AdaptiveStream::seek_time(double seek_seconds, bool preceeding, bool& needR
 
 bool AdaptiveStream::waitingForSegment(bool checkTime) const
 {
+  // The tree update lock is taken only after the stream has started to wait for a new segment,
+  // that is the only case where the representation can have the wait flag set
+  if (!m_isWaitingForSegment)
+    return false;
+
   if ((tree_.HasManifestUpdates() || tree_.HasManifestUpdatesSegs()) && state_ == RUNNING)
   {
     std::lock_guard<adaptive::AdaptiveTree::TreeUpdateThread> lckUpdTree(tree_.GetTreeUpdMutex());
@@ -1197,6 +2150,8 @@ bool AdaptiveStream::waitingForSegment(bool checkTime) const
              SecondsSinceUpdate() < 1;
     }
   }
+  // The manifest update has provided the new segment
+  m_isWaitingForSegment = false;
   return false;
 }
 
@@ -1267,9 +2222,26 @@ void AdaptiveStream::Stop()
 
   if (thread_data_)
   {
+    const auto stopStartTime = std::chrono::steady_clock::now();
     thread_data_->Stop();
     StopWorker(STOPPED);
+    const auto stopDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - stopStartTime);
+
+    LOG::Log(LOGDEBUG, "[AS-%u] Download workers stopped in %lld ms (retries: %u, aborts: %u)",
+             clsId, static_cast<long long>(stopDuration.count()), m_downloadRetries.load(),
+             m_downloadAborts.load());
   }
+
+  if (m_bufferBudget)
+    m_bufferBudget->RemoveClient(clsId);
+
+  LOG::Log(LOGDEBUG,
+           "[AS-%u] Segment reads: %llu lock-free, %llu locked, %llu views, %llu waits for data",
+           clsId, static_cast<unsigned long long>(m_lockFreeReads.load()),
+           static_cast<unsigned long long>(m_lockedReads.load()),
+           static_cast<unsigned long long>(m_viewReads.load()),
+           static_cast<unsigned long long>(m_readerWaits.load()));
 }
 
 void AdaptiveStream::clear()
@@ -1282,7 +2254,7 @@ void adaptive::AdaptiveStream::DisposeWorker()
 {
   if (thread_data_)
   {
-    if (worker_processing_)
+    if (active_downloads_ > 0)
     {
       LOG::LogF(LOGERROR, "[AS-%u] Cannot delete worker thread, download is in progress.", clsId);
       return;
@@ -9,8 +9,13 @@
 #pragma once
 
 #include "AdaptiveTree.h"
+#include "BufferBudget.h"
+#include "Chooser.h"
+#include "DownloadScheduler.h"
+#include "SegmentBufferPool.h"
 
 #include "samplereader/SampleReader.h"
+#include "utils/CurlUtils.h"
 
 #include <atomic>
 #include <condition_variable>
@@ -18,6 +23,7 @@
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace adaptive
 {
@@ -57,7 +63,8 @@ class AdaptiveStream;
 
     /*!
     * \brief Set the current segment to the one specified, and reset
-    *   the buffer
+    *   the buffer, the segments already prefetched from the new segment
+    *   onwards are kept in the buffer
     * \param newSegment The new segment
     */
     void ResetCurrentSegment(const PLAYLIST::CSegment* newSegment);
@@ -68,9 +75,78 @@ class AdaptiveStream;
 
     bool ensureSegment();
     uint32_t read(void* buffer, uint32_t  bytesToRead);
+
+    /*!
+    * \brief Read the data as a view of the current segment buffer, so without copying them,
+    *   the read position is advanced as done by read(). Possible only when the segment
+    *   download is completed and the data are in the current segment, otherwise read() must be used.
+    *   The data stay valid until the next call, also when meantime the reader switch to the
+    *   next segment, since the memory of the viewed segment buffer is retained.
+    * \param size The bytes to read
+    * \param data[OUT] The pointer to the data
+    * \return True if success, otherwise false
+    */
+    bool ReadView(uint32_t size, const uint8_t*& data);
+
+   /*!
+    * \brief Check if the current segment has data not read yet, or it is still downloading,
+    *        so the next read does not need to switch to the next segment.
+    * \return True if the current segment has data to read, otherwise false
+    */
+    bool HasSegmentDataToRead() const;
+
+   /*!
+    * \brief Get a view of the current segment data from the read position, without advancing
+    *   it. Possible only when the segment download is completed. The data stay valid until
+    *   the next view is requested, as for ReadView.
+    * \param data[OUT] The pointer to the data
+    * \param size[OUT] The bytes available from the pointer, until the end of the segment
+    * \return True if success, otherwise false
+    */
+    bool PeekView(const uint8_t*& data, size_t& size);
+
+   /*!
+    * \brief Advance the read position in the current segment without locking, to be used
+    *   after the data has been read from the view given by PeekView.
+    * \param size The bytes to skip
+    * \return True if success, otherwise false when the bytes exceed the segment data
+    */
+    bool SkipView(size_t size);
     uint64_t tell(){ read(0, 0);  return absolute_position_; };
     bool seek(uint64_t const pos);
 
+   /*!
+    * \brief Wait until the current segment has the data requested from a position, without
+    *   switching to the next segment and without changing the read position.
+    * \param pos The absolute position of the data
+    * \param size The bytes requested
+    * \return The bytes available from the position, less than requested only when the
+    *   segment download is completed
+    */
+    size_t WaitSegmentData(uint64_t pos, size_t size);
+
+    struct SEGMENTDATAID
+    {
+      const PLAYLIST::CRepresentation* m_rep{nullptr};
+      uint64_t m_segmentNumber{0};
+      uint64_t m_startPos{0}; // Absolute position of the segment start
+
+      bool operator==(const SEGMENTDATAID& other) const
+      {
+        return m_rep == other.m_rep && m_segmentNumber == other.m_segmentNumber &&
+               m_startPos == other.m_startPos;
+      }
+      bool operator!=(const SEGMENTDATAID& other) const { return !(*this == other); }
+    };
+
+   /*!
+    * \brief Get the identifier of the current segment data, the absolute positions are
+    *   not unique between the segments, so the data read from a position can be kept
+    *   only while the identifier is unchanged.
+    * \return The identifier, empty if the stream is stopped
+    */
+    SEGMENTDATAID GetSegmentDataId();
+
    /*!
     * \brief Get the buffer size of the first segment in the buffer
     * \param size The segment buffer size
@@ -98,6 +174,59 @@ class AdaptiveStream;
     */
     bool IsRequiredCreateMovieAtom();
 
+   /*!
+    * \brief Set the download scheduler shared by the streams of the session,
+    *        must be set before start the stream.
+    * \param scheduler The scheduler, or nullptr to download without limits
+    */
+    void SetDownloadScheduler(CDownloadScheduler* scheduler) { m_downloadScheduler = scheduler; }
+
+   /*!
+    * \brief Set the memory budget shared by the segment buffers of the streams of the session,
+    *        must be set before start the stream.
+    * \param budget The budget, or nullptr to limit the buffer by duration only
+    */
+    void SetBufferBudget(CBufferBudget* budget) { m_bufferBudget = budget; }
+
+   /*!
+    * \brief Set the pool that provide the memory of the segment buffers, shared by the streams
+    *        of the session, must be set before start the stream and be alive until the stream
+    *        is destroyed.
+    * \param pool The pool, or nullptr to let each segment buffer manage its own memory
+    */
+    void SetSegmentBufferPool(CSegmentBufferPool* pool) { m_segmentBufferPool = pool; }
+
+   /*!
+    * \brief Set if the stream is used as timing stream by the session,
+    *        the segments of the timing stream are downloaded with higher priority.
+    * \param isTimingStream Set true if timing stream, otherwise false
+    */
+    void SetIsTimingStream(bool isTimingStream) { m_isTimingStream = isTimingStream; }
+
+   /*!
+    * \brief Get the number of segments waiting for a download slot or in download.
+    * \return The download queue depth
+    */
+    size_t GetDownloadQueueDepth() const;
+
+   /*!
+    * \brief Get the number of segment download retries done after a failure.
+    * \return The retries count
+    */
+    uint32_t GetDownloadRetryCount() const { return m_downloadRetries; }
+
+   /*!
+    * \brief Get the number of segment downloads aborted after all retries failed.
+    * \return The aborts count
+    */
+    uint32_t GetDownloadAbortCount() const { return m_downloadAborts; }
+
+   /*!
+    * \brief Get the number of segment downloads abandoned to switch to a lower representation.
+    * \return The abandons count
+    */
+    uint32_t GetDownloadAbandonCount() const { return m_downloadAbandons; }
+
     std::string GetStreamParams() const { return m_streamParams; }
     std::map<std::string, std::string> GetStreamHeaders() const { return m_streamHeaders; }
 
@@ -120,28 +249,78 @@ class AdaptiveStream;
     struct SEGMENTBUFFER
     {
       std::vector<uint8_t> buffer;
+      // Size of the data in the buffer that can be read (committed length), the buffer size can be
+      // greater while a chunk is being written in place by the download worker, that publish the
+      // new data by increasing it, so the reader can copy the committed data without locking
+      std::atomic<size_t> data_size{0};
       PLAYLIST::CSegment segment;
       uint64_t segment_number{0};
       PLAYLIST::CRepresentation* rep{nullptr};
+      // Set when a download worker is writing the data to the buffer
+      std::atomic<bool> is_downloading{false};
+      // Decrypter IV used to decrypt HLS segment
+      uint8_t decrypter_iv[16]{};
     };
     std::vector<SEGMENTBUFFER*> segment_buffers_;
 
     void AllocateSegmentBuffers(size_t size);
     void DeallocateSegmentBuffers();
 
+   /*!
+    * \brief Scope guard to be held by the download worker, together with mutex_rw_, while the
+    *        memory of a segment buffer can be reallocated. Waits until the reader has finished
+    *        to copy the committed data without lock, and forces meantime the reader to lock.
+    */
+    class CReallocGuard
+    {
+    public:
+      explicit CReallocGuard(AdaptiveStream& stream);
+      ~CReallocGuard();
+
+    private:
+      AdaptiveStream& m_stream;
+    };
+
+   /*!
+    * \brief Publish the data written to the segment buffer, so can be read without locking,
+    *        the reader is woken up only when it is waiting for the data.
+    *        Must be called without holding mutex_rw_.
+    * \param segBuffer The segment buffer
+    * \param dataSize The new committed length
+    */
+    void CommitSegmentData(SEGMENTBUFFER& segBuffer, size_t dataSize);
+
+   /*!
+    * \brief Copy the data from the current segment buffer without locking, possible only
+    *        when the committed data are enough and no buffer memory reallocation is in progress.
+    * \param buffer[OUT] The buffer where to copy the data
+    * \param bytesToRead The bytes to copy
+    * \return True if the data has been copied, otherwise false to read with lock
+    */
+    bool ReadCommittedData(void* buffer, uint32_t bytesToRead);
+
     // Info to execute the download
     struct DownloadInfo
     {
       std::string m_url;
       std::map<std::string, std::string> m_addHeaders; // Additional headers
       SEGMENTBUFFER* m_segmentBuffer{nullptr}; // Optional, the segment buffer where to store the data
+      // Optional, the next segment buffers with contiguous byte ranges to be downloaded
+      // with the same request, the data is splitted to each buffer in sequence
+      std::vector<SEGMENTBUFFER*> m_coalescedBuffers;
+      // Number of coalesced segment buffers completed by the download, starting from m_segmentBuffer,
+      // once completed a segment buffer can be consumed and reused, so it must be no longer accessed
+      mutable size_t m_completedBuffers{0};
+      // Set when the download has been abandoned because too slow, the segment buffer
+      // has been switched to a lower representation and must be downloaded again
+      mutable bool m_isAbandoned{false};
     };
 
     std::string m_streamParams;
     std::map<std::string, std::string> m_streamHeaders;
 
    /*!
-    * \brief Download a file, the representation chooser will be updated with current download speed.
+    * \brief Download a file, the representation chooser will be updated with the transfer timings.
     * \param downloadInfo The info about the file to download
     * \param data[OUT] The downloaded data
     * \return Return true if success, otherwise false
@@ -151,8 +330,8 @@ class AdaptiveStream;
    /*!
     * \brief Download a segment file in chunks, the data could be also decrypted by the manifest parser,
     *        the download is done in chunks that will fill the segment buffer during the download,
-    *        while at same time can be read by the demux reader, when the download is finished
-    *        the representation chooser will be updated with current download speed.
+    *        while at same time can be read by the demux reader, the representation chooser
+    *        will be updated with the transfer timings of the chunks read.
     * \param downloadInfo The info about the file to download, its mandatory provide the segment buffer
     * \return Return true if success, otherwise false
     */
@@ -167,13 +346,128 @@ class AdaptiveStream;
     */
     bool DownloadImpl(const DownloadInfo& downloadInfo, std::vector<uint8_t>* data);
 
+   /*!
+    * \brief Reserve the capacity of the segment buffer to store the whole segment data,
+    *        to avoid memory reallocations while the chunks are downloaded.
+    *        The size is determined from the segment byte range, or from the content length.
+    * \param curl The opened url
+    * \param segBuffer The segment buffer to reserve
+    */
+    void ReserveSegmentBuffer(UTILS::CURL::CUrl& curl, SEGMENTBUFFER& segBuffer);
+
+   /*!
+    * \brief Clear the data of the segment buffer, when a pool is set the memory is released
+    *        to the pool, so that can be reused by segments of other sizes or other streams.
+    * \param segBuffer The segment buffer to clear
+    */
+    void ClearSegmentBuffer(SEGMENTBUFFER& segBuffer);
+
+   /*!
+    * \brief Release the memory detached from a segment buffer to keep valid a view, to be
+    *        called with m_viewMutex held. The memory is released to the pool, if any, so
+    *        the pool mutex is locked while holding m_viewMutex.
+    */
+    void ReleaseViewData();
+
+   /*!
+    * \brief Read the next chunk directly into the tail of the segment buffer, so without
+    *        intermediate buffers. To be used when the data dont need to be processed by the tree.
+    * \param curl The opened url to read
+    * \param segBuffer The segment buffer where to write the data
+    * \param maxChunkSize The max size of the chunk to read
+    * \param bytesRead[OUT] The chunk size read
+    * \return The read status
+    */
+    UTILS::CURL::ReadStatus ReadChunkInPlace(UTILS::CURL::CUrl& curl,
+                                             SEGMENTBUFFER& segBuffer,
+                                             size_t maxChunkSize,
+                                             size_t& bytesRead);
+
     bool PrepareNextDownload(DownloadInfo& downloadInfo);
+   /*!
+    * \brief Add to the download the next queued segment buffers that have a byte range contiguous
+    *        to the segment to download, so that they can be downloaded with a single request.
+    *        Must be called with the lock on mutex_dl_.
+    * \param downloadInfo The info about the download to extend
+    */
+    void CoalesceNextDownloads(DownloadInfo& downloadInfo);
+   /*!
+    * \brief Get the download scheduler priority for the segment buffer,
+    *        must be called with the lock on mutex_dl_.
+    * \param segBuffer The segment buffer to be downloaded
+    * \return The priority
+    */
+    CDownloadScheduler::Priority GetDownloadPriority(const SEGMENTBUFFER* segBuffer) const;
+   /*!
+    * \brief Get the buffer occupancy, from the duration of the downloaded segments,
+    *        must be called with the lock on mutex_dl_.
+    * \return The buffer status, with zero values if the segment durations are unknown
+    */
+    CHOOSER::BufferStatus GetBufferStatus() const;
+   /*!
+    * \brief Admission control of a segment to be queued in the segment buffer, the buffer
+    *        is limited by the seconds of media and by the memory budget of the session,
+    *        the segments within the assured buffer duration are admitted regardless of the
+    *        budget. Must be called with the lock on mutex_dl_.
+    * \param bufferPos The position in the segment buffer where the segment would be queued
+    * \param bufferedSecs The seconds of media already queued
+    * \param bufferedBytes The bytes of the segments already queued
+    * \param segmentSecs The segment duration in seconds, 0 if unknown
+    * \param segmentBytes The estimated segment size, 0 if unknown
+    * \return True if the segment can be queued, otherwise false
+    */
+    bool IsSegmentAdmitted(size_t bufferPos,
+                           double bufferedSecs,
+                           uint64_t bufferedBytes,
+                           double segmentSecs,
+                           uint64_t segmentBytes) const;
+   /*!
+    * \brief Get the time to wait before retry a failed download, based on the segment duration,
+    *        grows exponentially with the attempts and it is randomized (jitter).
+    * \param segBuffer The segment buffer of the failed download
+    * \param attempt The number of attempts done
+    * \return The delay
+    */
+    std::chrono::milliseconds GetRetryDelay(const SEGMENTBUFFER& segBuffer, size_t attempt) const;
+   /*!
+    * \brief Wait before retry a failed download, the wait is interrupted when the worker is stopped.
+    *        While the worker is paused the download is not waited by StopWorker(PAUSED), and
+    *        the retry is done only after the worker is running again, with the same attempt.
+    * \param delay The time to wait
+    * \return True to retry the download, otherwise false if the download is stopped
+    */
+    bool WaitRetryDelay(std::chrono::milliseconds delay);
+   /*!
+    * \brief Check the progress of a segment download, when the projected finish time exceeds
+    *        the buffer left before the segment is needed, the segment buffer is switched to
+    *        a lower representation of the same adaptation set, to be downloaded again.
+    *        The segment buffer is switched only when the demux reader has not started to read it.
+    *        Must be called without the locks on mutex_rw_ and mutex_dl_.
+    * \param segBuffer The segment buffer in download
+    * \param bytesRead The bytes downloaded
+    * \param bytesTotal The total bytes of the download
+    * \param transferSecs The seconds elapsed since the start of the data transfer
+    * \return True if the download must be abandoned, otherwise false
+    */
+    bool AbandonDownload(SEGMENTBUFFER& segBuffer,
+                         uint64_t bytesRead,
+                         uint64_t bytesTotal,
+                         double transferSecs);
     bool PrepareDownload(const PLAYLIST::CRepresentation* rep,
                          const PLAYLIST::CSegment& seg,
                          DownloadInfo& downloadInfo);
 
     void ResetSegment(const PLAYLIST::CSegment* segment);
     void ResetActiveBuffer(bool oneValid);
+   /*!
+    * \brief Find a segment in the segment buffers already downloaded, excluding the first one
+    *        that is in reading, must be called with the lock on mutex_rw_ and mutex_dl_.
+    * \param segment The segment of the current representation to find
+    * \param bufferPos[OUT] The position of the segment buffer
+    * \return The number of consecutive segment buffers downloaded starting from bufferPos,
+    *         or 0 if the segment is not prefetched
+    */
+    size_t FindPrefetchedSegment(const PLAYLIST::CSegment* segment, size_t& bufferPos) const;
     /*!
      * \brief Wait for download in progress is completed, then stop the worker
      * \return True if success, otherwise false if meantime the worker status is changed
@@ -196,45 +490,57 @@ class AdaptiveStream;
       {
       }
 
-      void Start(AdaptiveStream *parent)
+      // \brief Start the download workers, each worker download a segment at time.
+      void Start(AdaptiveStream* parent, uint32_t workers)
       {
-        download_thread_ = std::thread(&AdaptiveStream::worker, parent);
+        if (workers == 0)
+          workers = 1;
+
+        for (uint32_t i = 0; i < workers; i++)
+        {
+          download_threads_.emplace_back(&AdaptiveStream::worker, parent);
+        }
       }
 
       // \brief Stop the thread loop, make sure that dont enter in wait state again.
       void Stop()
       {
         thread_stop_ = true;
-        signal_dl_.notify_one(); // Unlock possible condition variable signal_dl_ in "wait" state
+        signal_dl_.notify_all(); // Unlock possible condition variable signal_dl_ in "wait" state
       }
 
       ~THREADDATA()
       {
         Stop();
-        if (download_thread_.joinable())
-          download_thread_.join();
+        for (std::thread& thread : download_threads_)
+        {
+          if (thread.joinable())
+            thread.join();
+        }
       };
 
       std::mutex mutex_rw_, mutex_dl_;
       std::condition_variable signal_rw_, signal_dl_;
-      std::thread download_thread_;
-      bool thread_stop_;
+      std::vector<std::thread> download_threads_;
+      std::atomic<bool> thread_stop_;
     };
     THREADDATA *thread_data_;
 
     AdaptiveTree &tree_;
     AdaptiveStreamObserver *observer_;
+    CDownloadScheduler* m_downloadScheduler{nullptr};
+    CBufferBudget* m_bufferBudget{nullptr};
+    CSegmentBufferPool* m_segmentBufferPool{nullptr};
+    std::atomic<bool> m_isTimingStream{false};
     // Active configuration
     PLAYLIST::CPeriod* current_period_;
     PLAYLIST::CAdaptationSet* current_adp_;
     PLAYLIST::CRepresentation* current_rep_;
 
-    // Decrypter IV used to decrypt HLS segment
-    // We need to store here because linked to representation
-    uint8_t m_decrypterIv[16];
-
-    // Minimum segment buffer size (segment_buffers_)
-    uint32_t assured_buffer_length_{0};
+    // Seconds of media always queued in the segment buffer, regardless of the memory budget
+    double m_bufferAssuredSecs{0};
+    // Max seconds of media queued in the segment buffer
+    double m_bufferMaxSecs{0};
     // The segment buffer size (segment_buffers_), so the max number of segments that can be downloaded and stored in memory
     uint32_t max_buffer_length_{0};
     // Number of segments stored in segment buffer (segment_buffers_) queued for downloading, always >= valid_segment_buffers_
@@ -243,11 +549,38 @@ class AdaptiveStream;
     size_t valid_segment_buffers_{0};
     PLAYLIST::CRepresentation* last_rep_; // used to align new live rep with old
 
-    std::size_t segment_read_pos_;
+    // Read position in the current segment buffer, can be read by the download worker
+    std::atomic<size_t> segment_read_pos_;
     uint64_t absolute_position_;
     uint64_t currentPTSOffset_, absolutePTSOffset_;
 
-    std::atomic<bool> worker_processing_;
+    // Number of segments currently in download by the download workers
+    std::atomic<size_t> active_downloads_{0};
+    // Downloads of active_downloads_ waiting to retry, protected by mutex_rw_
+    size_t m_retryWaits{0};
+    std::atomic<uint32_t> m_downloadRetries{0};
+    std::atomic<uint32_t> m_downloadAborts{0};
+    std::atomic<uint32_t> m_downloadAbandons{0};
+
+    // Handoff of the segment data between the download workers and the reader
+    std::atomic<bool> m_isReaderCopying{false}; // The reader is copying data without lock
+    std::atomic<bool> m_isReaderWaiting{false}; // The reader is waiting for data on signal_rw_
+    std::atomic<bool> m_isBufferReallocating{false}; // A buffer memory can be reallocated
+    std::atomic<uint64_t> m_lockFreeReads{0};
+    std::atomic<uint64_t> m_lockedReads{0};
+    std::atomic<uint64_t> m_readerWaits{0};
+    std::atomic<uint64_t> m_viewReads{0};
+    // Set when the stream wait for a new segment from the manifest update, cleared
+    // by waitingForSegment when the representation no longer waits
+    mutable std::atomic<bool> m_isWaitingForSegment{false};
+
+    // The segment buffer referenced by the last view returned by ReadView, when the segment
+    // buffer is cleared its memory is detached to m_viewData, to keep the view valid
+    SEGMENTBUFFER* m_viewBuffer{nullptr};
+    std::vector<uint8_t> m_viewData;
+    // Only the segment buffer pool mutex can be locked while holding it, the pool dont
+    // lock anything else, so there is no lock order issue with mutex_rw_
+    std::mutex m_viewMutex;
     bool m_fixateInitialization;
     uint64_t m_segmentFileOffset;
     bool play_timeshift_buffer_;
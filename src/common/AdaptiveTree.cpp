@@ -63,9 +63,17 @@ namespace adaptive
     // Convenience way to share common addon settings we avoid
     // calling the API many times to improve parsing performance
     m_settings.m_bufferAssuredDuration =
-        static_cast<uint32_t>(kodi::addon::GetSettingInt("ASSUREDBUFFERDURATION"));
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("ASSUREDBUFFERDURATION", 10));
     m_settings.m_bufferMaxDuration =
-        static_cast<uint32_t>(kodi::addon::GetSettingInt("MAXBUFFERDURATION"));
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("MAXBUFFERDURATION", 60));
+    m_settings.m_segmentDownloadWorkers =
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("segment.download.workers", 1));
+    m_settings.m_sessionMaxDownloads =
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("segment.download.sessionmax", 4));
+    m_settings.m_sessionMaxBufferSize =
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("segment.buffer.sessionmaxsize", 256));
+    m_settings.m_sampleReadAhead =
+        static_cast<uint32_t>(kodi::addon::GetSettingInt("sample.readahead", 1));
   }
 
   void AdaptiveTree::Uninitialize()
@@ -55,8 +55,18 @@ class ATTR_DLL_LOCAL AdaptiveTree
 public:
   struct Settings
   {
-    uint32_t m_bufferAssuredDuration{60};
-    uint32_t m_bufferMaxDuration{120};
+    // Seconds of media always buffered, also when the memory budget is exceeded
+    uint32_t m_bufferAssuredDuration{10};
+    // Max seconds of media buffered
+    uint32_t m_bufferMaxDuration{60};
+    // Number of segments that can be downloaded at same time by each stream
+    uint32_t m_segmentDownloadWorkers{1};
+    // Max number of segments that can be downloaded at same time by all streams of the session
+    uint32_t m_sessionMaxDownloads{4};
+    // Max size in MB of the segments buffered by all streams of the session
+    uint32_t m_sessionMaxBufferSize{256};
+    // Max number of samples read ahead by each stream sample reader
+    uint32_t m_sampleReadAhead{1};
   };
 
   std::vector<std::unique_ptr<PLAYLIST::CPeriod>> m_periods;
@@ -130,6 +140,15 @@ public:
     return std::chrono::system_clock::now();
   }
 
+  /*!
+   * \brief Determines if the downloaded data of a segment must be processed by OnDataArrived
+   *        (e.g. decrypted) before it can be read, otherwise the data can be written directly
+   *        to the segment buffer without be copied.
+   * \param psshSet The PSSHSet position of the segment
+   * \return True if the data must be processed, otherwise false
+   */
+  virtual bool IsDataProcessingRequired(uint16_t psshSet) const { return false; }
+
   virtual void OnDataArrived(uint64_t segNum,
                              uint16_t psshSet,
                              uint8_t iv[16],
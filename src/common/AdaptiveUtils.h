@@ -181,6 +181,37 @@ public:
     return realPos;
   };
 
+  /*!
+   * \brief Binary search the position of the first <T> value, following the positions order,
+   *        for which the predicate return false. The values must be partitioned by the predicate,
+   *        e.g. the segments are sorted by PTS and the predicate compare the PTS.
+   * \param pred The predicate
+   * \return The position found, otherwise GetSize() if the predicate return true for all values
+   */
+  template<typename Pred>
+  size_t PartitionPoint(Pred pred) const
+  {
+    size_t first{0};
+    size_t count{m_data.size()};
+
+    while (count > 0)
+    {
+      const size_t step{count / 2};
+      size_t realPos{m_basePos + first + step};
+      if (realPos >= m_data.size())
+        realPos -= m_data.size();
+
+      if (pred(m_data[realPos]))
+      {
+        first += step + 1;
+        count -= step + 1;
+      }
+      else
+        count = step;
+    }
+    return first;
+  }
+
   void Insert(const T& elem)
   {
     m_data[m_basePos] = elem;
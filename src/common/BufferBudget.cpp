@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "BufferBudget.h"
+
+using namespace adaptive;
+
+CBufferBudget::CBufferBudget(uint64_t maxBytes) : m_maxBytes{maxBytes}
+{
+}
+
+bool CBufferBudget::IsAvailable(uint32_t clientId, uint64_t bytes) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint64_t usedByOthers = m_usedBytes;
+  auto itClient = m_clientUsage.find(clientId);
+  if (itClient != m_clientUsage.end())
+    usedByOthers -= itClient->second;
+
+  return usedByOthers + bytes <= m_maxBytes;
+}
+
+void CBufferBudget::SetUsage(uint32_t clientId, uint64_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  uint64_t& clientBytes = m_clientUsage[clientId];
+  m_usedBytes = m_usedBytes - clientBytes + bytes;
+  clientBytes = bytes;
+}
+
+void CBufferBudget::RemoveClient(uint32_t clientId)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto itClient = m_clientUsage.find(clientId);
+  if (itClient != m_clientUsage.end())
+  {
+    m_usedBytes -= itClient->second;
+    m_clientUsage.erase(itClient);
+  }
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+namespace adaptive
+{
+
+/*!
+ * \brief Memory budget shared by the segment buffers of all the streams of a session,
+ *        each stream declares the bytes used by the segments queued in its buffer
+ *        and checks the budget before queuing new segments (admission control).
+ *        The budget is not a hard limit, the segments needed to fill the assured buffer
+ *        of a stream are queued regardless of it, so the usage can exceed the max bytes.
+ */
+class ATTR_DLL_LOCAL CBufferBudget
+{
+public:
+  /*!
+   * \param maxBytes The max bytes of the segments buffered by all the streams
+   */
+  explicit CBufferBudget(uint64_t maxBytes);
+
+  /*!
+   * \brief Check if the client can use the specified bytes without exceed the budget.
+   * \param clientId The client identifier (the AdaptiveStream class id)
+   * \param bytes The total bytes that would be used by the client
+   * \return True if the bytes are available, otherwise false
+   */
+  bool IsAvailable(uint32_t clientId, uint64_t bytes) const;
+
+  /*!
+   * \brief Set the bytes currently used by a client.
+   * \param clientId The client identifier
+   * \param bytes The total bytes used by the client
+   */
+  void SetUsage(uint32_t clientId, uint64_t bytes);
+
+  /*!
+   * \brief Remove a client, its bytes are released.
+   * \param clientId The client identifier
+   */
+  void RemoveClient(uint32_t clientId);
+
+  uint64_t GetMaxBytes() const { return m_maxBytes; }
+
+private:
+  uint64_t m_maxBytes;
+  uint64_t m_usedBytes{0};
+  std::map<uint32_t, uint64_t> m_clientUsage; // Client id, bytes used
+  mutable std::mutex m_mutex;
+};
+
+} // namespace adaptive
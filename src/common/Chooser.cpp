@@ -10,6 +10,7 @@
 
 #include "utils/log.h"
 #include "ChooserAskQuality.h"
+#include "ChooserBufferBased.h"
 #include "ChooserDefault.h"
 #include "ChooserFixedRes.h"
 #include "ChooserManualOSD.h"
@@ -19,6 +20,7 @@
 #include <kodi/gui/General.h>
 #endif
 
+#include <chrono>
 #include <vector>
 
 using namespace CHOOSER;
@@ -26,6 +28,16 @@ using namespace PLAYLIST;
 
 namespace
 {
+// Min duration of a throughput sample, the chunks read are grouped since
+// a single chunk could be read from the local network buffers in no time
+constexpr double THROUGHPUT_SAMPLE_DURATION = 0.1; // Seconds
+
+double GetTransferTime()
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 IRepresentationChooser* GetReprChooser(std::string_view type)
 {
   // Chooser's names are used for add-on settings and Kodi properties
@@ -37,6 +49,8 @@ IRepresentationChooser* GetReprChooser(std::string_view type)
     return new CRepresentationChooserAskQuality();
   else if (type == "manual-osd")
     return new CRepresentationChooserManualOSD();
+  else if (type == "buffer-based")
+    return new CRepresentationChooserBufferBased();
   else if (type == "test")
     return new CRepresentationChooserTest();
   else
@@ -76,6 +90,46 @@ CHOOSER::IRepresentationChooser::IRepresentationChooser()
   if (adjRefreshRate == AdjustRefreshRateStatus::ADJUST_REFRESHRATE_STATUS_ON_START ||
       adjRefreshRate == AdjustRefreshRateStatus::ADJUST_REFRESHRATE_STATUS_ON_STARTSTOP)
     m_isAdjustRefreshRate = true;
+
+  m_throughputEstimator = CreateThroughputEstimator(
+      kodi::addon::GetSettingString("adaptivestream.bandwidth.estimator"));
+  m_transferAggregator =
+      std::make_unique<CTransferAggregator>(*m_throughputEstimator, THROUGHPUT_SAMPLE_DURATION);
+}
+
+void CHOOSER::IRepresentationChooser::StartDownloadTransfer()
+{
+  std::lock_guard<std::mutex> lock(m_throughputMutex);
+  m_transferAggregator->StartTransfer(GetTransferTime());
+}
+
+void CHOOSER::IRepresentationChooser::AddDownloadData(size_t bytes)
+{
+  std::lock_guard<std::mutex> lock(m_throughputMutex);
+  m_transferAggregator->AddData(bytes, GetTransferTime());
+}
+
+void CHOOSER::IRepresentationChooser::EndDownloadTransfer()
+{
+  std::lock_guard<std::mutex> lock(m_throughputMutex);
+  m_transferAggregator->EndTransfer(GetTransferTime());
+}
+
+void CHOOSER::IRepresentationChooser::AddDownloadTimeToFirstByte(double seconds)
+{
+  std::lock_guard<std::mutex> lock(m_throughputMutex);
+  m_throughputEstimator->AddTimeToFirstByte(seconds);
+}
+
+bool CHOOSER::IRepresentationChooser::GetEstimatedThroughput(double& throughput, double& ttfb)
+{
+  std::lock_guard<std::mutex> lock(m_throughputMutex);
+  if (!m_throughputEstimator->HasSamples())
+    return false;
+
+  throughput = m_throughputEstimator->GetThroughput();
+  ttfb = m_throughputEstimator->GetTimeToFirstByte();
+  return true;
 }
 
 void CHOOSER::IRepresentationChooser::SetScreenResolution(const int width,
@@ -11,13 +11,25 @@
 #include "utils/PropertiesUtils.h"
 #include "utils/SettingsUtils.h"
 #include "AdaptiveTree.h"
+#include "ThroughputEstimator.h"
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string_view>
 #include <utility>
 
 namespace CHOOSER
 {
+/*!
+ * \brief The buffer occupancy of a stream
+ */
+struct BufferStatus
+{
+  double m_levelSecs{0}; // The seconds of media downloaded and ready to be read
+  double m_maxLevelSecs{0}; // The seconds of media that the buffer can hold
+};
+
 /*!
  * \brief Defines the behaviours on which the quality of streams is chosen
  */
@@ -60,6 +72,39 @@ public:
    */
   virtual void SetDownloadSpeed(const double speed) {}
 
+  /*!
+   * \brief Start a segment data transfer, when the response is received.
+   *        The data of the concurrent transfers are added together to the throughput
+   *        estimator, each transfer must be ended with EndDownloadTransfer.
+   */
+  void StartDownloadTransfer();
+
+  /*!
+   * \brief Add the data read by a segment transfer to the throughput estimator.
+   *        To be called while reading the data of a segment download.
+   * \param bytes The bytes transferred
+   */
+  void AddDownloadData(size_t bytes);
+
+  /*!
+   * \brief End a segment data transfer started with StartDownloadTransfer.
+   */
+  void EndDownloadTransfer();
+
+  /*!
+   * \brief Add the time to first byte of a segment request to the throughput estimator.
+   * \param seconds The time from the request to the response headers
+   */
+  void AddDownloadTimeToFirstByte(double seconds);
+
+  /*!
+   * \brief Set the current buffer occupancy of a stream.
+   *        To be called before each request of the next representation.
+   * \param streamType The stream type of the buffer
+   * \param status The buffer status
+   */
+  virtual void SetBufferStatus(PLAYLIST::StreamType streamType, const BufferStatus& status) {}
+
   /*!
    * \brief Get the stream selection mode. Determine whether to provide the user
    *        with the ability to choose a/v tracks from Kodi GUI settings while
@@ -71,6 +116,13 @@ public:
     return UTILS::SETTINGS::StreamSelection::AUTO;
   }
 
+  /*!
+   * \brief Determine if a segment download in progress can be abandoned to switch to
+   *        a lower quality, when the download is too slow to be completed in time.
+   * \return True if allowed, otherwise false
+   */
+  virtual bool IsDownloadAbandonAllowed() { return false; }
+
   /*!
    * \brief Called at each DRM initialization to set if the secure session is currently being used.
    * \param isSecureSession Set true if a secure session is in use
@@ -106,6 +158,14 @@ protected:
   void LogDetails(PLAYLIST::CRepresentation* currentRep,
                   PLAYLIST::CRepresentation* nextRep);
 
+  /*!
+   * \brief Get the throughput estimated from the segment downloads
+   * \param throughput[OUT] The throughput in byte/s
+   * \param ttfb[OUT] The time to first byte in seconds
+   * \return True if the estimation is available, otherwise false
+   */
+  bool GetEstimatedThroughput(double& throughput, double& ttfb);
+
   bool m_isSecureSession{false};
 
   // Current screen width resolution (this value is auto-updated by Kodi)
@@ -119,6 +179,10 @@ protected:
 
 private:
   bool m_isAdjustRefreshRate{false};
+
+  std::mutex m_throughputMutex;
+  std::unique_ptr<IThroughputEstimator> m_throughputEstimator;
+  std::unique_ptr<CTransferAggregator> m_transferAggregator;
 };
 
 IRepresentationChooser* CreateRepresentationChooser(
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ChooserBufferBased.h"
+
+#include "utils/log.h"
+#include "ReprSelector.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace CHOOSER;
+using namespace PLAYLIST;
+
+namespace
+{
+// Buffer below the reservoir (percentage of the max buffer level) use the lowest quality
+constexpr double RESERVOIR_FACTOR = 0.2;
+// Buffer over the cushion (percentage of the max buffer level) use the highest quality
+constexpr double CUSHION_FACTOR = 0.9;
+} // unnamed namespace
+
+CRepresentationChooserBufferBased::CRepresentationChooserBufferBased()
+{
+  LOG::Log(LOGDEBUG, "[Repr. chooser] Type: Buffer based");
+}
+
+void CRepresentationChooserBufferBased::SetBufferStatus(PLAYLIST::StreamType streamType,
+                                                        const BufferStatus& status)
+{
+  std::lock_guard<std::mutex> lock(m_bufferStatusMutex);
+  m_bufferStatus[streamType] = status;
+}
+
+PLAYLIST::CRepresentation* CRepresentationChooserBufferBased::GetNextRepresentation(
+    PLAYLIST::CAdaptationSet* adp, PLAYLIST::CRepresentation* currentRep)
+{
+  // On start/new period there is no buffer to rely on, the bandwidth is used instead
+  if (!currentRep || adp->GetStreamType() != StreamType::VIDEO)
+    return CRepresentationChooserDefault::GetNextRepresentation(adp, currentRep);
+
+  BufferStatus status;
+  {
+    std::lock_guard<std::mutex> lock(m_bufferStatusMutex);
+    auto itStatus = m_bufferStatus.find(StreamType::VIDEO);
+    if (itStatus != m_bufferStatus.end())
+      status = itStatus->second;
+  }
+
+  if (status.m_maxLevelSecs <= 0)
+    return CRepresentationChooserDefault::GetNextRepresentation(adp, currentRep);
+
+  if (!m_ignoreScreenRes && !m_ignoreScreenResChange)
+    CheckResolution();
+
+  // The representations allowed by the screen resolution and bandwidth limits,
+  // sorted from the lowest to the highest bandwidth
+  std::vector<CRepresentation*> reps;
+  for (auto& rep : adp->GetRepresentations())
+  {
+    if (rep->GetWidth() > m_screenWidth || rep->GetHeight() > m_screenHeight)
+      continue;
+    if (m_bandwidthMax > 0 && rep->GetBandwidth() > m_bandwidthMax)
+      continue;
+    reps.emplace_back(rep.get());
+  }
+
+  if (reps.empty())
+  {
+    CRepresentationSelector selector(m_screenWidth, m_screenHeight);
+    CRepresentation* nextRep = selector.Lowest(adp);
+    LogDetails(currentRep, nextRep);
+    return nextRep;
+  }
+
+  std::stable_sort(reps.begin(), reps.end(), [](const CRepresentation* a, const CRepresentation* b)
+                   { return a->GetBandwidth() < b->GetBandwidth(); });
+
+  const double reservoir = status.m_maxLevelSecs * RESERVOIR_FACTOR;
+  const double cushion = status.m_maxLevelSecs * CUSHION_FACTOR;
+  const double rateMin = reps.front()->GetBandwidth();
+  const double rateMax = reps.back()->GetBandwidth();
+
+  size_t nextIndex{0};
+
+  if (status.m_levelSecs <= reservoir)
+  {
+    nextIndex = 0;
+  }
+  else if (status.m_levelSecs >= cushion)
+  {
+    nextIndex = reps.size() - 1;
+  }
+  else
+  {
+    // The bandwidth mapped to the current buffer level
+    const double rateMapped =
+        rateMin + (status.m_levelSecs - reservoir) / (cushion - reservoir) * (rateMax - rateMin);
+
+    auto itCurrent = std::find(reps.begin(), reps.end(), currentRep);
+    if (itCurrent == reps.end())
+    {
+      // Current representation no longer allowed, take the highest under the mapped bandwidth
+      while (nextIndex + 1 < reps.size() && reps[nextIndex + 1]->GetBandwidth() <= rateMapped)
+        nextIndex++;
+    }
+    else
+    {
+      // Hysteresis: the representation is changed only when the mapped bandwidth
+      // crosses the bandwidth of an adjacent representation
+      const size_t currIndex = static_cast<size_t>(itCurrent - reps.begin());
+      nextIndex = currIndex;
+
+      if (currIndex + 1 < reps.size() && rateMapped >= reps[currIndex + 1]->GetBandwidth())
+      {
+        while (nextIndex + 1 < reps.size() && reps[nextIndex + 1]->GetBandwidth() <= rateMapped)
+          nextIndex++;
+      }
+      else if (currIndex > 0 && rateMapped <= reps[currIndex - 1]->GetBandwidth())
+      {
+        while (nextIndex > 0 && reps[nextIndex - 1]->GetBandwidth() >= rateMapped)
+          nextIndex--;
+      }
+    }
+  }
+
+  CRepresentation* nextRep = reps[nextIndex];
+
+  LOG::Log(LOGDEBUG, "[Repr. chooser] Current buffer level: %0.1lf secs (max %0.1lf secs)",
+           status.m_levelSecs, status.m_maxLevelSecs);
+  LogDetails(currentRep, nextRep);
+
+  return nextRep;
+}
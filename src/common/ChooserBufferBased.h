@@ -0,0 +1,41 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include "ChooserDefault.h"
+
+#include <map>
+#include <mutex>
+
+namespace CHOOSER
+{
+/*!
+ * \brief Buffer based stream, the quality of the video stream is changed according
+ *        to the seconds of media in the buffer instead of the download speed (BBA-0 like).
+ *        When the buffer level is under the reservoir the lowest quality is used,
+ *        then the quality is raised linearly with the buffer level up to the cushion.
+ *        Audio streams, and video streams without buffer status, are handled as default.
+ */
+class ATTR_DLL_LOCAL CRepresentationChooserBufferBased : public CRepresentationChooserDefault
+{
+public:
+  CRepresentationChooserBufferBased();
+  ~CRepresentationChooserBufferBased() override {}
+
+  void SetBufferStatus(PLAYLIST::StreamType streamType, const BufferStatus& status) override;
+
+  PLAYLIST::CRepresentation* GetNextRepresentation(PLAYLIST::CAdaptationSet* adp,
+                                                   PLAYLIST::CRepresentation* currentRep) override;
+
+private:
+  std::mutex m_bufferStatusMutex;
+  std::map<PLAYLIST::StreamType, BufferStatus> m_bufferStatus;
+};
+
+} // namespace CHOOSER
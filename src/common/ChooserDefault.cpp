@@ -14,7 +14,6 @@
 
 #include <algorithm>
 #include <cmath>
-#include <numeric>
 #include <string_view>
 
 using namespace CHOOSER;
@@ -160,22 +159,14 @@ void CRepresentationChooserDefault::RefreshResolution()
 
 void CRepresentationChooserDefault::SetDownloadSpeed(const double speed)
 {
-  m_downloadSpeedChron.push_back(speed);
-
-  // Calculate the average speed of last 10 download speeds
-  if (m_downloadSpeedChron.size() > 10)
-    m_downloadSpeedChron.pop_front();
+  // The download speed of the manifest, can be used as initial bandwidth
+  // until the segment downloads allow to estimate the throughput
+  SetBandwidth(static_cast<uint32_t>(speed * 8));
+}
 
-  // Calculate the current bandwidth from the average download speed
-  if (m_bandwidthCurrent == 0)
-    m_bandwidthCurrent = static_cast<uint32_t>(speed * 8);
-  else
-  {
-    double avgSpeedBytes{
-        std::accumulate(m_downloadSpeedChron.begin(), m_downloadSpeedChron.end(), 0.0) /
-        m_downloadSpeedChron.size()};
-    m_bandwidthCurrent = static_cast<uint32_t>(avgSpeedBytes * 8);
-  }
+void CRepresentationChooserDefault::SetBandwidth(uint32_t bandwidth)
+{
+  m_bandwidthCurrent = bandwidth;
 
   // Force the bandwidth to the limits set by the user or add-on
   m_bandwidthCurrentLimited = m_bandwidthCurrent;
@@ -193,6 +184,10 @@ PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
   if (isVideoStreamType && !m_ignoreScreenRes && !m_ignoreScreenResChange)
     CheckResolution();
 
+  double throughput;
+  if (GetEstimatedThroughput(throughput, m_ttfbCurrent))
+    SetBandwidth(static_cast<uint32_t>(throughput * 8));
+
   CRepresentationSelector selector(m_screenWidth, m_screenHeight);
   uint32_t bandwidth;
 
@@ -230,8 +225,10 @@ PLAYLIST::CRepresentation* CRepresentationChooserDefault::GetNextRepresentation(
 
   if (isVideoStreamType) // Only video, to avoid fill too much the log
   {
-    LOG::Log(LOGDEBUG, "[Repr. chooser] Current average bandwidth: %u bit/s (filtered to %u bit/s)",
-             m_bandwidthCurrent, bandwidth);
+    LOG::Log(LOGDEBUG,
+             "[Repr. chooser] Current estimated bandwidth: %u bit/s (filtered to %u bit/s), "
+             "time to first byte: %0.3lf secs",
+             m_bandwidthCurrent, bandwidth, m_ttfbCurrent);
     LogDetails(currentRep, nextRep);
   }
 
@@ -11,7 +11,6 @@
 #include "Chooser.h"
 
 #include <chrono>
-#include <deque>
 #include <optional>
 #include <utility>
 
@@ -33,6 +32,8 @@ public:
 
   void SetDownloadSpeed(const double speed) override;
 
+  bool IsDownloadAbandonAllowed() override { return true; }
+
   PLAYLIST::CRepresentation* GetNextRepresentation(PLAYLIST::CAdaptationSet* adp,
                                                    PLAYLIST::CRepresentation* currentRep) override;
 
@@ -47,6 +48,12 @@ protected:
    */
   void RefreshResolution();
 
+  /*!
+   * \brief Set the current bandwidth, limited by the user settings or add-on
+   * \param bandwidth The bandwidth in bit/s
+   */
+  void SetBandwidth(uint32_t bandwidth);
+
   int m_screenWidth{0};
   int m_screenHeight{0};
   std::optional<std::chrono::steady_clock::time_point> m_screenResLastUpdate;
@@ -59,7 +66,7 @@ protected:
   // Ignore resolution change, while it is playing only
   bool m_ignoreScreenResChange{false};
 
-  // The bandwidth (bit/s) calculated by the average download speed
+  // The bandwidth (bit/s) estimated from the segment downloads
   uint32_t m_bandwidthCurrent{0};
   // The average bandwidth (bit/s) that could be limited by user settings or add-on
   uint32_t m_bandwidthCurrentLimited{0};
@@ -71,7 +78,8 @@ protected:
   // Default initial bandwidth
   uint32_t m_bandwidthInit{0};
 
-  std::deque<double> m_downloadSpeedChron;
+  // The estimated time to first byte (secs) of the segment requests
+  double m_ttfbCurrent{0};
 };
 
 } // namespace CHOOSER
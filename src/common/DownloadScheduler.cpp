@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "DownloadScheduler.h"
+
+#include <algorithm>
+
+using namespace adaptive;
+
+CDownloadScheduler::CDownloadScheduler(uint32_t maxDownloads)
+  : m_maxDownloads{std::max(maxDownloads, 1U)}
+{
+}
+
+bool CDownloadScheduler::Acquire(uint32_t clientId,
+                                 Priority priority,
+                                 const void* tag,
+                                 const std::function<bool()>& isCancelled)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  auto itRequest =
+      m_waiting.insert(m_waiting.end(), Request{clientId, priority, tag, m_sequence++});
+
+  while (!isCancelled() &&
+         (m_activeDownloads >= m_maxDownloads || !IsNextRequest(*itRequest)))
+  {
+    m_cv.wait(lock);
+  }
+
+  m_waiting.erase(itRequest);
+
+  if (isCancelled())
+  {
+    // Another request could be now the next one to be served
+    m_cv.notify_all();
+    return false;
+  }
+
+  // The requests still waiting have been bypassed, count it for the aging
+  for (Request& request : m_waiting)
+    request.m_bypassCount++;
+
+  m_activeDownloads++;
+  m_clientActive[clientId]++;
+  return true;
+}
+
+void CDownloadScheduler::Release(uint32_t clientId)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_activeDownloads > 0)
+      m_activeDownloads--;
+
+    auto itClient = m_clientActive.find(clientId);
+    if (itClient != m_clientActive.end() && --itClient->second == 0)
+      m_clientActive.erase(itClient);
+  }
+  m_cv.notify_all();
+}
+
+void CDownloadScheduler::Promote(uint32_t clientId, const void* tag)
+{
+  bool isPromoted{false};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (Request& request : m_waiting)
+    {
+      if (request.m_clientId == clientId && request.m_tag == tag &&
+          request.m_priority != Priority::URGENT)
+      {
+        request.m_priority = Priority::URGENT;
+        isPromoted = true;
+        break;
+      }
+    }
+  }
+  if (isPromoted)
+    m_cv.notify_all();
+}
+
+void CDownloadScheduler::Interrupt()
+{
+  // Lock to avoid that a waiting request miss the notification
+  // between the evaluation of cancel callback and the wait
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cv.notify_all();
+}
+
+size_t CDownloadScheduler::GetQueueDepth(uint32_t clientId) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  size_t depth = std::count_if(m_waiting.cbegin(), m_waiting.cend(), [clientId](const Request& r)
+                               { return r.m_clientId == clientId; });
+
+  auto itClient = m_clientActive.find(clientId);
+  if (itClient != m_clientActive.end())
+    depth += itClient->second;
+
+  return depth;
+}
+
+CDownloadScheduler::Priority CDownloadScheduler::GetEffectivePriority(const Request& request)
+{
+  if (request.m_priority >= Priority::HIGH)
+    return request.m_priority;
+
+  // The aging never reach the urgent priority, reserved to the requests blocking the demuxer
+  const uint32_t level =
+      static_cast<uint32_t>(request.m_priority) + request.m_bypassCount / AGING_GRANTS;
+  return static_cast<Priority>(std::min(level, static_cast<uint32_t>(Priority::HIGH)));
+}
+
+bool CDownloadScheduler::IsNextRequest(const Request& request) const
+{
+  const Priority priority = GetEffectivePriority(request);
+
+  for (const Request& other : m_waiting)
+  {
+    const Priority otherPriority = GetEffectivePriority(other);
+    if (otherPriority > priority ||
+        (otherPriority == priority && other.m_sequence < request.m_sequence))
+    {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+namespace adaptive
+{
+
+/*!
+ * \brief Shared scheduler to limit the number of segment downloads in progress at same time
+ *        by all the streams of a session. The download workers of each stream must acquire
+ *        a download slot before start a download, the slots are granted by priority,
+ *        so the video/timing stream is served before audio and subtitles, while a request
+ *        that the demux reader is waiting for (urgent) is served before any prefetch.
+ *        To avoid the starvation of low priority requests under a steady load, a waiting
+ *        request is raised by one priority level every AGING_GRANTS slots granted to other
+ *        requests while it waits, up to the HIGH priority level.
+ */
+class ATTR_DLL_LOCAL CDownloadScheduler
+{
+public:
+  enum class Priority
+  {
+    LOW = 0, // e.g. subtitles
+    NORMAL, // e.g. audio
+    HIGH, // e.g. video or the timing stream
+    URGENT, // The demux reader is waiting for the segment
+  };
+
+  /*!
+   * \param maxDownloads The max number of downloads in progress at same time
+   */
+  explicit CDownloadScheduler(uint32_t maxDownloads);
+
+  // Number of slots granted to other requests that raise a waiting request by one priority level
+  static constexpr uint32_t AGING_GRANTS = 4;
+
+  /*!
+   * \brief Wait for a free download slot, the caller must call Release once the download is finished.
+   * \param clientId The client identifier (the AdaptiveStream class id)
+   * \param priority The priority of the request
+   * \param tag Identify the request of the client, can be used later to promote the request
+   * \param isCancelled Callback evaluated while waiting, when return true the request is cancelled
+   * \return True if the slot has been acquired, otherwise false if the request is cancelled
+   */
+  bool Acquire(uint32_t clientId,
+               Priority priority,
+               const void* tag,
+               const std::function<bool()>& isCancelled);
+
+  /*!
+   * \brief Release a download slot previously acquired.
+   * \param clientId The client identifier
+   */
+  void Release(uint32_t clientId);
+
+  /*!
+   * \brief Promote a request still waiting for a slot to urgent priority,
+   *        to be used when the demux reader is blocked waiting for the data.
+   * \param clientId The client identifier
+   * \param tag The request tag
+   */
+  void Promote(uint32_t clientId, const void* tag);
+
+  /*!
+   * \brief Wake up all the waiting requests to evaluate again their cancel callback.
+   */
+  void Interrupt();
+
+  /*!
+   * \brief Get the number of requests of a client waiting for a slot or in download.
+   * \param clientId The client identifier
+   * \return The queue depth
+   */
+  size_t GetQueueDepth(uint32_t clientId) const;
+
+  uint32_t GetMaxDownloads() const { return m_maxDownloads; }
+
+private:
+  struct Request
+  {
+    uint32_t m_clientId{0};
+    Priority m_priority{Priority::NORMAL};
+    const void* m_tag{nullptr};
+    uint64_t m_sequence{0};
+    uint32_t m_bypassCount{0}; // Number of slots granted to other requests while waiting
+  };
+
+  // Get the priority of the request raised by the aging
+  static Priority GetEffectivePriority(const Request& request);
+
+  // Return true if the request is the first to be served between the waiting ones
+  bool IsNextRequest(const Request& request) const;
+
+  uint32_t m_maxDownloads;
+  uint32_t m_activeDownloads{0};
+  uint64_t m_sequence{0};
+  std::list<Request> m_waiting;
+  std::map<uint32_t, size_t> m_clientActive; // Client id, number of downloads in progress
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+};
+
+} // namespace adaptive
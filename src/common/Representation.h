@@ -104,11 +104,12 @@ public:
   void SetHdcpVersion(uint16_t hdcpVersion) { m_hdcpVersion = hdcpVersion; }
 
   CSpinCache<CSegment>& SegmentTimeline() { return m_segmentTimeline; }
-  CSpinCache<CSegment> SegmentTimeline() const { return m_segmentTimeline; }
-  bool HasSegmentTimeline() { return !m_segmentTimeline.IsEmpty(); }
+  // Read only access to the timeline, without copy it
+  const CSpinCache<CSegment>& SegmentTimeline() const { return m_segmentTimeline; }
+  bool HasSegmentTimeline() const { return !m_segmentTimeline.IsEmpty(); }
 
   std::optional<CSegmentTemplate>& GetSegmentTemplate() { return m_segmentTemplate; }
-  std::optional<CSegmentTemplate> GetSegmentTemplate() const { return m_segmentTemplate; }
+  const std::optional<CSegmentTemplate>& GetSegmentTemplate() const { return m_segmentTemplate; }
   void SetSegmentTemplate(const CSegmentTemplate& segTemplate) { m_segmentTemplate = segTemplate; }
   bool HasSegmentTemplate() const { return m_segmentTemplate.has_value(); }
 
@@ -93,10 +93,10 @@ CSegment PLAYLIST::CSegmentTemplate::MakeInitSegment()
 }
 
 std::string PLAYLIST::CSegmentTemplate::FormatUrl(std::string_view url,
-                                                  const std::string id,
+                                                  std::string_view id,
                                                   const uint32_t bandwidth,
                                                   const uint64_t number,
-                                                  const uint64_t time)
+                                                  const uint64_t time) const
 {
   size_t curPos{0};
   std::string ret;
@@ -159,7 +159,7 @@ std::string PLAYLIST::CSegmentTemplate::FormatUrl(std::string_view url,
 }
 
 std::string PLAYLIST::CSegmentTemplate::FormatIdentifier(std::string_view identifier,
-                                                         const uint64_t value)
+                                                         const uint64_t value) const
 {
   if (identifier.back() == '$')
     identifier.remove_suffix(1);
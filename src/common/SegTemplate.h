@@ -53,13 +53,13 @@ public:
   CSegment MakeInitSegment();
 
   std::string FormatUrl(std::string_view url,
-                        const std::string id,
+                        std::string_view id,
                         const uint32_t bandwidth,
                         const uint64_t number,
-                        const uint64_t time);
+                        const uint64_t time) const;
 
 private:
-  std::string FormatIdentifier(std::string_view identifier, const uint64_t value);
+  std::string FormatIdentifier(std::string_view identifier, const uint64_t value) const;
 
   std::string m_initialization;
   std::string m_media;
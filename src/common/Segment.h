@@ -30,6 +30,8 @@ public:
 
   //! @todo: create getters/setters
 
+  // The data members are ordered to avoid padding, since the timelines can have many segments
+
   // Byte range start
   uint64_t range_begin_ = NO_VALUE;
   // Byte range end
@@ -37,10 +39,10 @@ public:
   std::string url;
   uint64_t startPTS_ = NO_PTS_VALUE;
   uint64_t m_duration = 0; // If available gives the media duration of a segment (depends on type of stream e.g. HLS)
-  uint16_t pssh_set_ = PSSHSET_POS_DEFAULT;
 
   uint64_t m_time{0};
   uint64_t m_number{0};
+  uint16_t pssh_set_ = PSSHSET_POS_DEFAULT;
 
   /*!
    * \brief Determines if it is an initialization segment.
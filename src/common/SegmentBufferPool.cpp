@@ -0,0 +1,200 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "SegmentBufferPool.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace adaptive;
+
+namespace
+{
+constexpr size_t MIN_CLASS_SIZE = 64 * 1024;
+constexpr size_t MAX_CLASS_SIZE = 32 * 1024 * 1024;
+
+// Size classes in power of two steps, each one with an intermediate step
+// to limit the wasted space for the segments sizes between two powers
+const std::vector<size_t>& GetClassSizes()
+{
+  static const std::vector<size_t> classSizes = []
+  {
+    std::vector<size_t> sizes;
+    for (size_t size = MIN_CLASS_SIZE; size <= MAX_CLASS_SIZE; size *= 2)
+    {
+      sizes.emplace_back(size);
+      if (size < MAX_CLASS_SIZE)
+        sizes.emplace_back(size + size / 2);
+    }
+    return sizes;
+  }();
+  return classSizes;
+}
+} // unnamed namespace
+
+CSegmentBufferPool::CSegmentBufferPool(uint64_t maxBytes)
+  : m_maxBytes{maxBytes}, m_freeBlocks(GetClassSizes().size())
+{
+}
+
+void CSegmentBufferPool::Acquire(std::vector<uint8_t>& buffer, size_t capacity)
+{
+  const size_t classSize = GetClassSize(capacity);
+  std::vector<uint8_t> block;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    SyncUsage(buffer);
+    if (buffer.capacity() >= capacity)
+      return;
+
+    const int classIndex = GetClassIndex(classSize);
+    if (classIndex >= 0 && GetClassSizes()[classIndex] == classSize &&
+        !m_freeBlocks[classIndex].empty())
+    {
+      block = std::move(m_freeBlocks[classIndex].back());
+      m_freeBlocks[classIndex].pop_back();
+      m_stats.m_cachedBytes -= block.capacity();
+      m_stats.m_reuses++;
+    }
+  }
+
+  if (block.capacity() == 0)
+  {
+    block.reserve(classSize);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.m_allocations++;
+  }
+
+  block.assign(buffer.cbegin(), buffer.cend());
+  buffer.swap(block);
+  block.clear();
+
+  // Now the block is the previous storage of the buffer
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_stats.m_inUseBytes = m_stats.m_inUseBytes - block.capacity() + buffer.capacity();
+  m_bufferUsage[&buffer] = buffer.capacity();
+  UpdatePeaks();
+  // When not cached the block is freed after the unlock
+  CacheBlock(block);
+}
+
+void CSegmentBufferPool::Release(std::vector<uint8_t>& buffer)
+{
+  // Declared before the lock, so when not cached the block is freed after the unlock
+  std::vector<uint8_t> block;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  SyncUsage(buffer);
+  m_bufferUsage.erase(&buffer);
+
+  if (buffer.capacity() == 0)
+    return;
+
+  block.swap(buffer);
+  block.clear();
+  m_stats.m_inUseBytes -= block.capacity();
+  CacheBlock(block);
+}
+
+void CSegmentBufferPool::Transfer(std::vector<uint8_t>& src, std::vector<uint8_t>& dest)
+{
+  Release(dest);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  SyncUsage(src);
+  m_bufferUsage.erase(&src);
+  if (src.capacity() > 0)
+    m_bufferUsage[&dest] = src.capacity();
+
+  dest.swap(src);
+}
+
+void CSegmentBufferPool::Trim()
+{
+  std::vector<std::vector<std::vector<uint8_t>>> freeBlocks(GetClassSizes().size());
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_freeBlocks.swap(freeBlocks);
+    m_stats.m_cachedBytes = 0;
+  }
+  // The blocks are freed here, outside the lock
+}
+
+CSegmentBufferPool::Stats CSegmentBufferPool::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+size_t CSegmentBufferPool::GetClassSize(size_t capacity)
+{
+  const std::vector<size_t>& classSizes = GetClassSizes();
+  auto itClass = std::lower_bound(classSizes.cbegin(), classSizes.cend(), capacity);
+  if (itClass != classSizes.cend())
+    return *itClass;
+
+  // Grow geometrically, to not reallocate the buffer at each chunk of a big segment
+  size_t size = MAX_CLASS_SIZE;
+  while (size < capacity && size <= std::numeric_limits<size_t>::max() / 2)
+    size *= 2;
+
+  return std::max(size, capacity);
+}
+
+int CSegmentBufferPool::GetClassIndex(size_t capacity)
+{
+  const std::vector<size_t>& classSizes = GetClassSizes();
+  auto itClass = std::upper_bound(classSizes.cbegin(), classSizes.cend(), capacity);
+  return static_cast<int>(std::distance(classSizes.cbegin(), itClass)) - 1;
+}
+
+void CSegmentBufferPool::SyncUsage(const std::vector<uint8_t>& buffer)
+{
+  const size_t capacity = buffer.capacity();
+  auto itBuffer = m_bufferUsage.find(&buffer);
+
+  // A buffer not acquired from the pool or grown outside of it, e.g. when the data are
+  // processed by the tree, is accounted with its current capacity
+  if (itBuffer == m_bufferUsage.end())
+  {
+    if (capacity == 0)
+      return;
+    itBuffer = m_bufferUsage.emplace(&buffer, 0).first;
+  }
+
+  m_stats.m_inUseBytes = m_stats.m_inUseBytes - itBuffer->second + capacity;
+  itBuffer->second = capacity;
+  UpdatePeaks();
+}
+
+void CSegmentBufferPool::CacheBlock(std::vector<uint8_t>& block)
+{
+  const uint64_t blockSize = block.capacity();
+  const int classIndex = GetClassIndex(block.capacity());
+
+  if (classIndex >= 0 &&
+      m_stats.m_inUseBytes + m_stats.m_cachedBytes + blockSize <= m_maxBytes)
+  {
+    m_stats.m_cachedBytes += blockSize;
+    m_freeBlocks[classIndex].emplace_back(std::move(block));
+    UpdatePeaks();
+  }
+}
+
+void CSegmentBufferPool::UpdatePeaks()
+{
+  m_stats.m_peakInUseBytes = std::max(m_stats.m_peakInUseBytes, m_stats.m_inUseBytes);
+  m_stats.m_peakCachedBytes = std::max(m_stats.m_peakCachedBytes, m_stats.m_cachedBytes);
+  m_stats.m_peakTotalBytes =
+      std::max(m_stats.m_peakTotalBytes, m_stats.m_inUseBytes + m_stats.m_cachedBytes);
+}
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+namespace adaptive
+{
+
+/*!
+ * \brief Session-wide pool of the memory blocks used to store the segment payloads,
+ *        shared by all the streams of a session. The blocks are grouped in size classes
+ *        (power of two steps with an intermediate step, from 64 KiB to 32 MiB) so that a
+ *        block released by a stream can be reused for a segment of similar size,
+ *        also by another stream or after a representation change, without reallocation.
+ *        Over the biggest size class the blocks are grown geometrically, so a segment of
+ *        unknown size read by chunks is not copied at each chunk.
+ *        The free blocks are cached until the memory in use plus the cached memory
+ *        exceed the pool limit, then the exceeding blocks are freed.
+ *        The memory in use is accounted by buffer, also when a buffer is grown outside the pool.
+ */
+class ATTR_DLL_LOCAL CSegmentBufferPool
+{
+public:
+  struct Stats
+  {
+    uint64_t m_inUseBytes{0}; // Capacity of the blocks handed out to the streams
+    uint64_t m_cachedBytes{0}; // Capacity of the free blocks kept for the reuse
+    uint64_t m_peakInUseBytes{0};
+    uint64_t m_peakCachedBytes{0};
+    uint64_t m_peakTotalBytes{0}; // Peak of in use plus cached memory
+    uint64_t m_allocations{0}; // Number of blocks allocated
+    uint64_t m_reuses{0}; // Number of blocks served from the cache
+  };
+
+  /*!
+   * \param maxBytes The max memory that can be held by the blocks in use plus the cached ones
+   */
+  explicit CSegmentBufferPool(uint64_t maxBytes);
+
+  /*!
+   * \brief Ensure that the buffer has at least the specified capacity, if not the buffer
+   *        storage is replaced with a block of the pool, the current data is preserved
+   *        and the previous storage is released to the pool.
+   * \param buffer The buffer
+   * \param capacity The min capacity required
+   */
+  void Acquire(std::vector<uint8_t>& buffer, size_t capacity);
+
+  /*!
+   * \brief Release the buffer storage to the pool, the buffer is left empty without capacity.
+   * \param buffer The buffer
+   */
+  void Release(std::vector<uint8_t>& buffer);
+
+  /*!
+   * \brief Move the storage of a buffer to another one, keeping its memory accounted as in use.
+   *        The storage of the destination buffer is released to the pool.
+   * \param src The buffer to be left empty
+   * \param dest The buffer that take the storage
+   */
+  void Transfer(std::vector<uint8_t>& src, std::vector<uint8_t>& dest);
+
+  /*!
+   * \brief Free all the cached blocks, e.g. at the end of a period.
+   */
+  void Trim();
+
+  /*!
+   * \brief Get the current memory usage and the high-water marks.
+   * \return The pool statistics
+   */
+  Stats GetStats() const;
+
+  uint64_t GetMaxBytes() const { return m_maxBytes; }
+
+  /*!
+   * \brief Get the block size of the size class that can store the specified capacity.
+   * \param capacity The capacity required
+   * \return The block size, when exceed the biggest size class the biggest size doubled
+   *         as many times as needed
+   */
+  static size_t GetClassSize(size_t capacity);
+
+private:
+  // Return the index of the biggest size class that fit in the specified capacity,
+  // or -1 when the capacity is less than the smallest size class
+  static int GetClassIndex(size_t capacity);
+
+  // Update the memory in use with the buffer capacity, that can be changed outside the pool
+  void SyncUsage(const std::vector<uint8_t>& buffer);
+
+  // Move a free block to the cache when there is room, otherwise it is left to the caller
+  void CacheBlock(std::vector<uint8_t>& block);
+
+  void UpdatePeaks();
+
+  const uint64_t m_maxBytes;
+  std::vector<std::vector<std::vector<uint8_t>>> m_freeBlocks; // Free blocks, by size class
+  std::map<const std::vector<uint8_t>*, size_t> m_bufferUsage; // Buffer, capacity accounted
+  Stats m_stats;
+  mutable std::mutex m_mutex;
+};
+
+} // namespace adaptive
@@ -0,0 +1,150 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "ThroughputEstimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace CHOOSER;
+
+namespace
+{
+// Samples shorter than this are mostly read from the local network buffers
+// and would give a transfer rate not related to the network throughput
+constexpr double SAMPLE_MIN_DURATION = 0.01; // Seconds
+// The weight of the last time to first byte in its moving average
+constexpr double TTFB_WEIGHT = 0.2;
+} // unnamed namespace
+
+void CHOOSER::IThroughputEstimator::AddSample(size_t bytes, double seconds)
+{
+  if (bytes == 0 || seconds < SAMPLE_MIN_DURATION)
+    return;
+
+  OnSample(static_cast<double>(bytes) / seconds, seconds);
+  m_samplesCount++;
+}
+
+void CHOOSER::IThroughputEstimator::AddTimeToFirstByte(double seconds)
+{
+  if (seconds < 0)
+    return;
+
+  if (m_ttfb == 0)
+    m_ttfb = seconds;
+  else
+    m_ttfb = TTFB_WEIGHT * seconds + (1.0 - TTFB_WEIGHT) * m_ttfb;
+}
+
+CHOOSER::CThroughputHarmonicMean::CThroughputHarmonicMean(size_t windowSize)
+  : m_windowSize{std::max<size_t>(windowSize, 1)}
+{
+}
+
+double CHOOSER::CThroughputHarmonicMean::GetThroughput() const
+{
+  if (m_rates.empty())
+    return 0;
+
+  double inverseRatesSum{0};
+  for (double rate : m_rates)
+    inverseRatesSum += 1.0 / rate;
+
+  return static_cast<double>(m_rates.size()) / inverseRatesSum;
+}
+
+void CHOOSER::CThroughputHarmonicMean::OnSample(double rate, double seconds)
+{
+  m_rates.emplace_back(rate);
+
+  if (m_rates.size() > m_windowSize)
+    m_rates.pop_front();
+}
+
+CHOOSER::CThroughputDualEwma::CThroughputDualEwma(double fastHalfLife, double slowHalfLife)
+{
+  m_fast.m_halfLife = fastHalfLife;
+  m_slow.m_halfLife = slowHalfLife;
+}
+
+double CHOOSER::CThroughputDualEwma::GetThroughput() const
+{
+  return std::min(m_fast.Get(), m_slow.Get());
+}
+
+void CHOOSER::CThroughputDualEwma::OnSample(double rate, double seconds)
+{
+  m_fast.Add(rate, seconds);
+  m_slow.Add(rate, seconds);
+}
+
+void CHOOSER::CThroughputDualEwma::Ewma::Add(double value, double weight)
+{
+  const double alpha = std::pow(0.5, weight / m_halfLife);
+  m_estimate = value * (1.0 - alpha) + alpha * m_estimate;
+  m_totalWeight += weight;
+}
+
+double CHOOSER::CThroughputDualEwma::Ewma::Get() const
+{
+  if (m_totalWeight <= 0)
+    return 0;
+
+  // Remove the bias towards zero of the initial estimate
+  const double zeroFactor = 1.0 - std::pow(0.5, m_totalWeight / m_halfLife);
+  return m_estimate / zeroFactor;
+}
+
+CHOOSER::CTransferAggregator::CTransferAggregator(IThroughputEstimator& estimator,
+                                                  double sampleDuration)
+  : m_estimator{estimator}, m_sampleDuration{sampleDuration}
+{
+}
+
+void CHOOSER::CTransferAggregator::StartTransfer(double time)
+{
+  // The idle time before the first transfer is not part of the sample
+  if (m_activeTransfers++ == 0)
+  {
+    m_sampleStartTime = time;
+    m_sampleBytes = 0;
+  }
+}
+
+void CHOOSER::CTransferAggregator::AddData(size_t bytes, double time)
+{
+  m_sampleBytes += bytes;
+
+  if (time - m_sampleStartTime >= m_sampleDuration)
+    AddPendingSample(time);
+}
+
+void CHOOSER::CTransferAggregator::EndTransfer(double time)
+{
+  if (m_activeTransfers == 0)
+    return;
+
+  if (--m_activeTransfers == 0)
+    AddPendingSample(time);
+}
+
+void CHOOSER::CTransferAggregator::AddPendingSample(double time)
+{
+  m_estimator.AddSample(m_sampleBytes, time - m_sampleStartTime);
+  m_sampleStartTime = time;
+  m_sampleBytes = 0;
+}
+
+std::unique_ptr<IThroughputEstimator> CHOOSER::CreateThroughputEstimator(std::string_view type)
+{
+  if (type == "harmonic-mean")
+    return std::make_unique<CThroughputHarmonicMean>(20);
+
+  return std::make_unique<CThroughputDualEwma>(3.0, 8.0);
+}
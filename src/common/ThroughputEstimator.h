@@ -0,0 +1,190 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string_view>
+
+#ifdef INPUTSTREAM_TEST_BUILD
+#include "test/KodiStubs.h"
+#else
+#include <kodi/AddonBase.h>
+#endif
+
+namespace CHOOSER
+{
+/*!
+ * \brief Estimate the network throughput from the timings of the downloads.
+ *        The transfer rate is estimated separately from the time to first byte,
+ *        so that the request latency does not distort the rate of the data transfer.
+ */
+class ATTR_DLL_LOCAL IThroughputEstimator
+{
+public:
+  virtual ~IThroughputEstimator() = default;
+
+  /*!
+   * \brief Add a transfer sample, e.g. a group of chunks read while downloading a file.
+   * \param bytes The bytes transferred
+   * \param seconds The time spent to transfer the bytes
+   */
+  void AddSample(size_t bytes, double seconds);
+
+  /*!
+   * \brief Add the time to first byte of a request.
+   * \param seconds The time from the request to the response headers
+   */
+  void AddTimeToFirstByte(double seconds);
+
+  /*!
+   * \brief Get the estimated throughput.
+   * \return The throughput in byte/s, or 0 if there are no samples
+   */
+  virtual double GetThroughput() const = 0;
+
+  /*!
+   * \brief Get the estimated time to first byte.
+   * \return The time in seconds, or 0 if there are no samples
+   */
+  double GetTimeToFirstByte() const { return m_ttfb; }
+
+  /*!
+   * \brief Check if at least a transfer sample has been added.
+   * \return True if there are samples, otherwise false
+   */
+  bool HasSamples() const { return m_samplesCount > 0; }
+
+protected:
+  /*!
+   * \brief Update the estimation with a new valid transfer sample.
+   * \param rate The transfer rate in byte/s
+   * \param seconds The duration of the sample
+   */
+  virtual void OnSample(double rate, double seconds) = 0;
+
+private:
+  size_t m_samplesCount{0};
+  double m_ttfb{0};
+};
+
+/*!
+ * \brief Harmonic mean of the transfer rates in a sliding window of samples,
+ *        a single high outlier (e.g. data served from a cache) has a small effect.
+ */
+class ATTR_DLL_LOCAL CThroughputHarmonicMean : public IThroughputEstimator
+{
+public:
+  /*!
+   * \param windowSize The max number of samples used for the mean
+   */
+  explicit CThroughputHarmonicMean(size_t windowSize);
+
+  double GetThroughput() const override;
+
+protected:
+  void OnSample(double rate, double seconds) override;
+
+private:
+  size_t m_windowSize;
+  std::deque<double> m_rates;
+};
+
+/*!
+ * \brief Exponential weighted moving averages with a fast and a slow half-life
+ *        based on the sample duration, the lowest value between the two is used,
+ *        so the estimation drops quickly and grows slowly.
+ */
+class ATTR_DLL_LOCAL CThroughputDualEwma : public IThroughputEstimator
+{
+public:
+  /*!
+   * \param fastHalfLife The half-life in seconds of the fast average
+   * \param slowHalfLife The half-life in seconds of the slow average
+   */
+  CThroughputDualEwma(double fastHalfLife, double slowHalfLife);
+
+  double GetThroughput() const override;
+
+protected:
+  void OnSample(double rate, double seconds) override;
+
+private:
+  struct Ewma
+  {
+    void Add(double value, double weight);
+    double Get() const;
+
+    double m_halfLife{0};
+    double m_estimate{0};
+    double m_totalWeight{0};
+  };
+
+  Ewma m_fast;
+  Ewma m_slow;
+};
+
+/*!
+ * \brief Group the data of the concurrent transfers in samples of the total bytes transferred
+ *        over the wall time, so the estimator gets the throughput of the link instead of the
+ *        rate of each transfer, that with N concurrent transfers is about N times lower.
+ *        The time when there are no transfers in progress is not part of the samples.
+ */
+class ATTR_DLL_LOCAL CTransferAggregator
+{
+public:
+  /*!
+   * \param estimator The estimator where to add the samples
+   * \param sampleDuration The min duration in seconds of a sample, the data read are grouped
+   *        since a single chunk could be read from the local network buffers in no time
+   */
+  CTransferAggregator(IThroughputEstimator& estimator, double sampleDuration);
+
+  /*!
+   * \brief Start a transfer, when the first data are available.
+   * \param time The current time in seconds
+   */
+  void StartTransfer(double time);
+
+  /*!
+   * \brief Add the data read by a transfer started with StartTransfer.
+   * \param bytes The bytes read
+   * \param time The current time in seconds
+   */
+  void AddData(size_t bytes, double time);
+
+  /*!
+   * \brief End a transfer started with StartTransfer, when there are no other transfers
+   *        in progress the pending data are added to the estimator.
+   * \param time The current time in seconds
+   */
+  void EndTransfer(double time);
+
+  size_t GetActiveTransfers() const { return m_activeTransfers; }
+
+private:
+  void AddPendingSample(double time);
+
+  IThroughputEstimator& m_estimator;
+  double m_sampleDuration;
+  size_t m_activeTransfers{0};
+  double m_sampleStartTime{0};
+  size_t m_sampleBytes{0};
+};
+
+/*!
+ * \brief Create a throughput estimator.
+ * \param type The estimator type name, "harmonic-mean" or "ewma"
+ * \return The estimator, fallback to "ewma" for unknown types
+ */
+ATTR_DLL_LOCAL std::unique_ptr<IThroughputEstimator> CreateThroughputEstimator(
+    std::string_view type);
+
+} // namespace CHOOSER
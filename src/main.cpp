@@ -453,11 +453,12 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
 
     if (sr)
     {
-      AP4_Size iSize(sr->GetSampleDataSize());
-      const AP4_UI08* pData(sr->GetSampleData());
+      const ISampleReader::DemuxSample sample{sr->GetDemuxSample()};
+      AP4_Size iSize(sample.m_dataSize);
+      const AP4_UI08* pData(sample.m_data);
       bool srHaveData{iSize > 0 && pData};
 
-      if (sr->IsEncrypted() && srHaveData)
+      if (sample.m_isEncrypted && srHaveData)
       {
         const unsigned int numSubSamples(*(reinterpret_cast<const unsigned int*>(pData)));
         pData += sizeof(numSubSamples);
@@ -470,8 +471,8 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
         pData += 16;
         std::memcpy(p->cryptoInfo->kid, pData, 16);
         pData += 16;
-        iSize -= static_cast<AP4_Size>(pData - sr->GetSampleData());
-        CryptoInfo cryptoInfo = sr->GetReaderCryptoInfo();
+        iSize -= static_cast<AP4_Size>(pData - sample.m_data);
+        const CryptoInfo& cryptoInfo = sample.m_cryptoInfo;
         p->cryptoInfo->numSubSamples = numSubSamples;
         p->cryptoInfo->cryptBlocks = cryptoInfo.m_cryptBlocks;
         p->cryptoInfo->skipBlocks = cryptoInfo.m_skipBlocks;
@@ -483,10 +484,10 @@ DEMUX_PACKET* CInputStreamAdaptive::DemuxRead(void)
 
       if (srHaveData)
       {
-        p->dts = static_cast<double>(sr->DTS());
-        p->pts = static_cast<double>(sr->PTS());
-        p->duration = static_cast<double>(sr->GetDuration());
-        p->iStreamId = sr->GetStreamId();
+        p->dts = static_cast<double>(sample.m_dts);
+        p->pts = static_cast<double>(sample.m_pts);
+        p->duration = static_cast<double>(sample.m_duration);
+        p->iStreamId = sample.m_streamId;
         p->iGroupId = 0;
         p->iSize = iSize;
         std::memcpy(p->pData, pData, iSize);
@@ -25,6 +25,7 @@
 #include <numeric> // accumulate
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 using namespace pugi;
 using namespace kodi::tools;
@@ -84,6 +85,21 @@ std::string DetectCodecFromMimeType(std::string_view mimeType)
   return "";
 }
 
+// \brief Get the key to match the same adaptation set between manifest updates
+std::string GetAdpSetKey(const CAdaptationSet& adpSet)
+{
+  std::string key{adpSet.GetId()};
+  key += '\n';
+  key += adpSet.GetGroup();
+  key += '\n';
+  key += std::to_string(static_cast<int>(adpSet.GetStreamType()));
+  key += '\n';
+  key += adpSet.GetMimeType();
+  key += '\n';
+  key += adpSet.GetLanguage();
+  return key;
+}
+
 } // unnamed namespace
 
 
@@ -1169,6 +1185,8 @@ uint64_t adaptive::CDashTree::ParseTagSegmentTimeline(xml_node nodeSegTL,
   if (segTemplate)
     startNumber = segTemplate->GetStartNumber();
 
+  const bool isNewTimeline = SCTimeline.IsEmpty();
+
   // Parse <S> tags - e.g. <S t="3600" d="900000" r="2398"/>
   uint64_t nextPts{0};
   for (xml_node node : nodeSegTL.children("S"))
@@ -1218,6 +1236,12 @@ uint64_t adaptive::CDashTree::ParseTagSegmentTimeline(xml_node nodeSegTL,
     }
   }
 
+  // The capacity reserved is an estimation, release the unused memory only when
+  // the estimation is far from the real size, since shrink copy the whole timeline
+  std::vector<CSegment>& timelineData = SCTimeline.GetData();
+  if (isNewTimeline && timelineData.capacity() - timelineData.size() > timelineData.size() / 4)
+    timelineData.shrink_to_fit();
+
   return startPts;
 }
 
@@ -1615,29 +1639,36 @@ void adaptive::CDashTree::RefreshLiveSegments()
   if (urlHaveStartNumber && updateTree->m_firstStartNumber < nextStartNumber)
     return;
 
+  // Index the periods by ID, to merge the updates without nested linear searches
+  std::unordered_map<std::string_view, CPeriod*> periodIndex;
+  for (auto& period : m_periods)
+  {
+    if (!period->GetId().empty())
+      periodIndex.emplace(period->GetId(), period.get());
+  }
+
   for (size_t index{0}; index < updateTree->m_periods.size(); index++)
   {
     auto& updPeriod = updateTree->m_periods[index];
 
+    CPeriod* period{nullptr};
+
     // find matching period based on ID
-    auto itPeriod =
-        std::find_if(m_periods.begin(), m_periods.end(),
-                      [&updPeriod](const std::unique_ptr<CPeriod>& item)
-                      { return !item->GetId().empty() && item->GetId() == updPeriod->GetId(); });
+    auto itPeriod = periodIndex.find(updPeriod->GetId());
+    if (itPeriod != periodIndex.end())
+      period = itPeriod->second;
+
     // if not found, try matching period based on start
-    if (itPeriod == m_periods.end())
+    if (!period)
     {
-      itPeriod =
+      auto itStartPeriod =
           std::find_if(m_periods.begin(), m_periods.end(),
                         [&updPeriod](const std::unique_ptr<CPeriod>& item)
                         { return item->GetStart() && item->GetStart() == updPeriod->GetStart(); });
+      if (itStartPeriod != m_periods.end())
+        period = (*itStartPeriod).get();
     }
 
-    CPeriod* period{nullptr};
-
-    if (itPeriod != m_periods.end())
-      period = (*itPeriod).get();
-
     if (!period && updPeriod->GetId().empty() && updPeriod->GetStart() == 0)
     {
       // not found, fallback match based on position
@@ -1653,31 +1684,42 @@ void adaptive::CDashTree::RefreshLiveSegments()
 
       updPeriod->SetSequence(m_periodCurrentSeq++);
       m_periods.push_back(std::move(updPeriod));
+      if (!m_periods.back()->GetId().empty())
+        periodIndex.emplace(m_periods.back()->GetId(), m_periods.back().get());
       continue;
     }
 
+    // Index the adaptation sets and their representations by keys
+    std::unordered_multimap<std::string, CAdaptationSet*> adpSetIndex;
+    std::unordered_map<CAdaptationSet*, std::unordered_map<std::string_view, CRepresentation*>>
+        reprIndex;
+
+    for (auto& adpSet : period->GetAdaptationSets())
+    {
+      adpSetIndex.emplace(GetAdpSetKey(*adpSet), adpSet.get());
+
+      auto& adpSetReprs = reprIndex[adpSet.get()];
+      for (auto& repr : adpSet->GetRepresentations())
+      {
+        adpSetReprs.emplace(repr->GetId(), repr.get());
+      }
+    }
+
     for (auto& updAdpSet : updPeriod->GetAdaptationSets())
     {
       // Locate adaptationset
       if (!updAdpSet)
         continue;
 
-      for (auto& adpSet : period->GetAdaptationSets())
+      auto adpSetRange = adpSetIndex.equal_range(GetAdpSetKey(*updAdpSet));
+      for (auto itAdpSet = adpSetRange.first; itAdpSet != adpSetRange.second; ++itAdpSet)
       {
-        if (!(adpSet->GetId() == updAdpSet->GetId() &&
-              adpSet->GetGroup() == updAdpSet->GetGroup() &&
-              adpSet->GetStreamType() == updAdpSet->GetStreamType() &&
-              adpSet->GetMimeType() == updAdpSet->GetMimeType() &&
-              adpSet->GetLanguage() == updAdpSet->GetLanguage()))
-          continue;
+        const auto& adpSetReprs = reprIndex[itAdpSet->second];
 
         for (auto& updRepr : updAdpSet->GetRepresentations())
         {
           // Locate representation
-          auto itRepr = std::find_if(adpSet->GetRepresentations().begin(),
-                                      adpSet->GetRepresentations().end(),
-                                      [&updRepr](const std::unique_ptr<CRepresentation>& item)
-                                      { return item->GetId() == updRepr->GetId(); });
+          auto itRepr = adpSetReprs.find(updRepr->GetId());
 
           if (!updRepr->SegmentTimeline().Get(0))
           {
@@ -1688,9 +1730,9 @@ void adaptive::CDashTree::RefreshLiveSegments()
           }
 
           // Found representation
-          if (itRepr != adpSet->GetRepresentations().end())
+          if (itRepr != adpSetReprs.end())
           {
-            auto repr = (*itRepr).get();
+            CRepresentation* repr = itRepr->second;
 
             if (!repr->SegmentTimeline().IsEmpty())
             {
@@ -1745,55 +1787,50 @@ void adaptive::CDashTree::RefreshLiveSegments()
                 //! @todo: check if first element or size differs
                 uint64_t segmentId = repr->getCurrentSegmentNumber();
 
+                auto& reprSegTL = repr->SegmentTimeline();
+
                 if (repr->HasSegmentTimeline())
                 {
                   uint64_t search_pts = updRepr->SegmentTimeline().Get(0)->m_time;
-                  uint64_t misaligned = 0;
-                  for (const auto& segment : repr->SegmentTimeline().GetData())
+                  // Skip the segments before the first updated one
+                  const size_t pos = reprSegTL.PartitionPoint(
+                      [search_pts](const CSegment& segment) { return segment.m_time < search_pts; });
+
+                  if (pos < reprSegTL.GetSize() && reprSegTL.Get(pos)->m_time > search_pts)
                   {
-                    if (misaligned)
-                    {
-                      uint64_t ptsDiff = segment.m_time - (&segment - 1)->m_time;
-                      // our misalignment is small ( < 2%), let's decrement the start number
-                      if (misaligned < (ptsDiff * 2 / 100))
-                        repr->SetStartNumber(repr->GetStartNumber() - 1);
-                      break;
-                    }
-                    if (segment.m_time == search_pts)
-                      break;
-                    else if (segment.m_time > search_pts)
+                    if (pos == 0)
+                      repr->SetStartNumber(repr->GetStartNumber() - 1);
+                    else
                     {
-                      if (&repr->SegmentTimeline().GetData().front() == &segment)
+                      repr->SetStartNumber(repr->GetStartNumber() + pos);
+
+                      uint64_t misaligned = search_pts - reprSegTL.Get(pos - 1)->m_time;
+                      if (pos + 1 < reprSegTL.GetSize())
                       {
-                        repr->SetStartNumber(repr->GetStartNumber() - 1);
-                        break;
+                        uint64_t ptsDiff = reprSegTL.Get(pos + 1)->m_time - reprSegTL.Get(pos)->m_time;
+                        // our misalignment is small ( < 2%), let's decrement the start number
+                        if (misaligned < (ptsDiff * 2 / 100))
+                          repr->SetStartNumber(repr->GetStartNumber() - 1);
                       }
-                      misaligned = search_pts - (&segment - 1)->m_time;
                     }
-                    else
-                      repr->SetStartNumber(repr->GetStartNumber() + 1);
                   }
+                  else
+                    repr->SetStartNumber(repr->GetStartNumber() + pos);
                 }
                 else if (updRepr->SegmentTimeline().Get(0)->startPTS_ ==
-                          repr->SegmentTimeline().Get(0)->startPTS_)
+                          reprSegTL.Get(0)->startPTS_)
                 {
                   uint64_t search_re = updRepr->SegmentTimeline().Get(0)->m_number;
-                  for (const auto& segment : repr->SegmentTimeline().GetData())
-                  {
-                    if (segment.m_number >= search_re)
-                      break;
-                    repr->SetStartNumber(repr->GetStartNumber() + 1);
-                  }
+                  const size_t pos = reprSegTL.PartitionPoint(
+                      [search_re](const CSegment& segment) { return segment.m_number < search_re; });
+                  repr->SetStartNumber(repr->GetStartNumber() + pos);
                 }
                 else
                 {
                   uint64_t search_pts = updRepr->SegmentTimeline().Get(0)->startPTS_;
-                  for (const auto& segment : repr->SegmentTimeline().GetData())
-                  {
-                    if (segment.startPTS_ >= search_pts)
-                      break;
-                    repr->SetStartNumber(repr->GetStartNumber() + 1);
-                  }
+                  const size_t pos = reprSegTL.PartitionPoint(
+                      [search_pts](const CSegment& segment) { return segment.startPTS_ < search_pts; });
+                  repr->SetStartNumber(repr->GetStartNumber() + pos);
                 }
 
                 updRepr->SegmentTimeline().GetData().swap(repr->SegmentTimeline().GetData());
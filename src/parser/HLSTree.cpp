@@ -611,6 +611,12 @@ PLAYLIST::PrepareRepStatus adaptive::CHLSTree::prepareRepresentation(PLAYLIST::C
   return prepareStatus;
 }
 
+bool adaptive::CHLSTree::IsDataProcessingRequired(uint16_t psshSet) const
+{
+  // Must match the condition used by OnDataArrived to decrypt the data
+  return psshSet && m_currentPeriod->GetEncryptionState() != EncryptionState::ENCRYPTED_SUPPORTED;
+}
+
 void adaptive::CHLSTree::OnDataArrived(uint64_t segNum,
                                        uint16_t psshSet,
                                        uint8_t iv[16],
@@ -620,7 +626,7 @@ void adaptive::CHLSTree::OnDataArrived(uint64_t segNum,
                                        size_t segBufferSize,
                                        bool isLastChunk)
 {
-  if (psshSet && m_currentPeriod->GetEncryptionState() != EncryptionState::ENCRYPTED_SUPPORTED)
+  if (IsDataProcessingRequired(psshSet))
   {
     std::lock_guard<TreeUpdateThread> lckUpdTree(GetTreeUpdMutex());
 
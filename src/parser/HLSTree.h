@@ -44,6 +44,8 @@ public:
                                                             PLAYLIST::CRepresentation* rep,
                                                             bool update = false) override;
 
+  virtual bool IsDataProcessingRequired(uint16_t psshSet) const override;
+
   virtual void OnDataArrived(uint64_t segNum,
                              uint16_t psshSet,
                              uint8_t iv[16],
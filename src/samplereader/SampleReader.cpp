@@ -0,0 +1,190 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "SampleReader.h"
+
+#include <algorithm>
+
+ISampleReader::~ISampleReader()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    m_isStopping = true;
+  }
+  m_readCv.notify_all();
+
+  if (m_readWorker.joinable())
+    m_readWorker.join();
+}
+
+void ISampleReader::SetReadAhead(size_t depth, std::function<bool()> canReadAhead)
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_readAheadDepth = std::max<size_t>(depth, 1);
+  m_canReadAhead = std::move(canReadAhead);
+  // With depth 1 the sample is demuxed directly from the reader, the ring is not used
+  m_ring.resize(m_readAheadDepth > 1 ? m_readAheadDepth : 0);
+  m_ringHead = 0;
+  m_ringCount = 0;
+}
+
+void ISampleReader::ReadSampleAsync()
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+
+  // The worker thread is kept for the reader lifetime, instead of a thread for each sample
+  if (!m_readWorker.joinable())
+    m_readWorker = std::thread(&ISampleReader::ReadWorker, this);
+
+  m_readSampleCount++;
+
+  // Without samples read ahead, the reader has the sample just demuxed
+  if (m_ringCount > 0)
+    m_demuxPtsDiff = m_ring[m_ringHead].m_sample.m_ptsDiff;
+  else if (!m_isReading)
+    m_demuxPtsDiff = GetPTSDiff();
+
+  // Release the sample just demuxed
+  if (m_ringCount > 0)
+  {
+    m_ringHead = (m_ringHead + 1) % m_ring.size();
+    m_ringCount--;
+  }
+
+  if (m_ringCount == 0)
+  {
+    m_isReadRequested = true;
+    m_isReadAheadStopped = false;
+  }
+  m_isReadAheadPaused = false;
+  m_readCv.notify_all();
+}
+
+void ISampleReader::WaitReadSampleAsyncComplete()
+{
+  std::unique_lock<std::mutex> lock(m_readMutex);
+  m_isReadAheadPaused = true;
+  m_readCv.wait(lock, [this] { return !m_isReadRequested && !m_isReading; });
+}
+
+bool ISampleReader::IsReadSampleAsyncWorking()
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  return m_ringCount == 0 && (m_isReadRequested || m_isReading);
+}
+
+void ISampleReader::ClearReadAhead()
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  m_ringHead = 0;
+  m_ringCount = 0;
+  m_isReadAheadStopped = false;
+}
+
+ISampleReader::DemuxSample ISampleReader::GetDemuxSample()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    if (m_ringCount > 0)
+      return m_ring[m_ringHead].m_sample;
+  }
+  return GetReaderSample();
+}
+
+int64_t ISampleReader::GetDemuxPTSDiff()
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  if (m_ringCount > 0)
+    return m_ring[m_ringHead].m_sample.m_ptsDiff;
+
+  // The next sample to be demuxed is being read, the reader state cannot be accessed
+  if (m_isReadRequested || m_isReading)
+    return m_demuxPtsDiff;
+
+  return GetPTSDiff();
+}
+
+uint64_t ISampleReader::GetReadSampleCount()
+{
+  std::lock_guard<std::mutex> lock(m_readMutex);
+  return m_readSampleCount;
+}
+
+ISampleReader::DemuxSample ISampleReader::GetReaderSample() const
+{
+  DemuxSample sample;
+  sample.m_data = GetSampleData();
+  sample.m_dataSize = GetSampleDataSize();
+  sample.m_dts = DTS();
+  sample.m_pts = PTS();
+  sample.m_dtsOrPts = DTSorPTS();
+  sample.m_duration = GetDuration();
+  sample.m_ptsDiff = GetPTSDiff();
+  sample.m_streamId = GetStreamId();
+  sample.m_isEncrypted = IsEncrypted();
+  sample.m_isEOS = EOS();
+  sample.m_cryptoInfo = GetReaderCryptoInfo();
+  return sample;
+}
+
+void ISampleReader::ReadWorker()
+{
+  std::unique_lock<std::mutex> lock(m_readMutex);
+
+  while (true)
+  {
+    m_readCv.wait(lock, [this] { return m_isStopping || m_isReadRequested || CanReadAhead(); });
+    if (m_isStopping)
+      break;
+
+    m_isReading = true;
+    // The ring tail slot is not accessed by the consumer until the sample is pushed
+    const size_t tail = m_ring.empty() ? 0 : (m_ringHead + m_ringCount) % m_ring.size();
+    lock.unlock();
+
+    const AP4_Result result = ReadSample();
+    const bool isReadFailed = AP4_FAILED(result) || EOS() || GetSampleDataSize() == 0;
+
+    if (m_readAheadDepth > 1)
+    {
+      ReadySample& readySample = m_ring[tail];
+      readySample.m_sample = GetReaderSample();
+      readySample.m_data.assign(readySample.m_sample.m_data,
+                                readySample.m_sample.m_data + readySample.m_sample.m_dataSize);
+      if (readySample.m_sample.m_data)
+        readySample.m_sample.m_data = readySample.m_data.data();
+    }
+
+    lock.lock();
+    if (m_readAheadDepth > 1)
+      m_ringCount++;
+
+    m_isReading = false;
+    m_isReadRequested = false;
+    // Wait for the consumer before try again, e.g. the data of the next segment are not available
+    if (isReadFailed)
+      m_isReadAheadStopped = true;
+
+    m_readCv.notify_all();
+  }
+}
+
+bool ISampleReader::CanReadAhead()
+{
+  // Read ahead only to extend a ring that already has the sample to be demuxed,
+  // otherwise the current sample of the reader is the one to be demuxed
+  if (m_readAheadDepth <= 1 || m_ringCount == 0 || m_ringCount >= m_readAheadDepth ||
+      m_isReadAheadPaused || m_isReadAheadStopped)
+    return false;
+
+  // The start PTS can still be set by the session
+  if (GetStartPTS() == STREAM_NOPTS_VALUE)
+    return false;
+
+  return !m_canReadAhead || m_canReadAhead();
+}
@@ -20,7 +20,11 @@
 #include <kodi/addon-instance/Inputstream.h>
 #endif
 
-#include <future>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 class ATTR_DLL_LOCAL SampleReaderObserver
 {
@@ -34,7 +38,29 @@ public:
 class ATTR_DLL_LOCAL ISampleReader
 {
 public:
-  virtual ~ISampleReader() = default;
+  /*!
+   * \brief The sample to be demuxed, with the data needed to fill the demux packet
+   */
+  struct DemuxSample
+  {
+    const AP4_Byte* m_data{nullptr};
+    AP4_Size m_dataSize{0};
+    uint64_t m_dts{0};
+    uint64_t m_pts{0};
+    uint64_t m_dtsOrPts{0};
+    uint64_t m_duration{0};
+    int64_t m_ptsDiff{0}; // The reader PTS diff when the sample has been read
+    AP4_UI32 m_streamId{0};
+    bool m_isEncrypted{false};
+    bool m_isEOS{false};
+    CryptoInfo m_cryptoInfo;
+  };
+
+  /*!
+   * \brief The worker thread must be idle, so WaitReadSampleAsyncComplete must be called
+   *        before destroy the reader, since the derived class is already destroyed here
+   */
+  virtual ~ISampleReader();
   virtual bool Initialize() { return true; };
   virtual bool EOS() const = 0;
   virtual uint64_t DTS() const = 0;
@@ -60,7 +86,13 @@ public:
   virtual uint32_t GetTimeScale() const = 0;
   virtual AP4_UI32 GetStreamId() const = 0;
   virtual AP4_Size GetSampleDataSize() const = 0;
+
+  /*!
+   * \brief Get the data of the current sample, valid until the next sample is read
+   * \return The sample data
+   */
   virtual const AP4_Byte* GetSampleData() const = 0;
+
   virtual uint64_t GetDuration() const = 0;
   virtual bool IsEncrypted() const = 0;
   virtual void AddStreamType(INPUTSTREAM_TYPE type, uint32_t sid) {};
@@ -70,32 +102,61 @@ public:
   virtual CryptoInfo GetReaderCryptoInfo() const { return CryptoInfo(); }
 
   /*!
-   * \brief Read the sample asynchronously
+   * \brief Set the number of samples that can be kept ready to be demuxed. When greater
+   *        than one, the worker thread continue to read the next samples while the
+   *        current ones are demuxed, the read samples are copied in a ring of this size.
+   *        With one, only the requested sample is read and the sample data is not copied.
+   *        To be set before the first ReadSampleAsync call.
+   * \param depth The max number of samples ready to be demuxed
+   * \param canReadAhead Callback to check if a sample can be read ahead without waiting
+   *        for new data, e.g. the next segment of the stream
    */
-  void ReadSampleAsync()
-  {
-    m_readSampleAsyncState = std::async(std::launch::async, &ISampleReader::ReadSample, this);
-  }
+  void SetReadAhead(size_t depth, std::function<bool()> canReadAhead);
 
   /*!
-   * \brief Wait for the asynchronous ReadSample to complete
+   * \brief Release the current sample to be demuxed and read the next one asynchronously
    */
-  void WaitReadSampleAsyncComplete()
-  {
-    if (m_readSampleAsyncState.valid())
-      m_readSampleAsyncState.wait();
-  }
+  void ReadSampleAsync();
 
   /*!
-   * \brief Check if the async ReadSample is working
-   * \return Return true if is working, otherwise false
+   * \brief Wait for the asynchronous ReadSample to complete, the read-ahead is paused
+   *        until the next ReadSampleAsync call, so the reader can be safely used after it.
    */
-  bool IsReadSampleAsyncWorking()
-  {
-    return m_readSampleAsyncState.valid() &&
-           m_readSampleAsyncState.wait_for(std::chrono::milliseconds(0)) !=
-               std::future_status::ready;
-  }
+  void WaitReadSampleAsyncComplete();
+
+  /*!
+   * \brief Check if the async ReadSample is working, without waiting
+   * \return Return true if the next sample to be demuxed is not ready, otherwise false
+   */
+  bool IsReadSampleAsyncWorking();
+
+  /*!
+   * \brief Discard the samples read ahead, to be called after WaitReadSampleAsyncComplete
+   *        when the reader is repositioned, e.g. by Reset or TimeSeek
+   */
+  void ClearReadAhead();
+
+  /*!
+   * \brief Get the sample to be demuxed, that is the first sample read ahead, if any,
+   *        otherwise the current sample of the reader.
+   *        The data is valid until the next ReadSampleAsync call.
+   * \return The sample to be demuxed
+   */
+  DemuxSample GetDemuxSample();
+
+  /*!
+   * \brief Get the PTS diff of the sample to be demuxed, as GetPTSDiff when the sample has
+   *        been read. The reader can be reading ahead the next samples, so GetPTSDiff must
+   *        not be used, except after WaitReadSampleAsyncComplete.
+   * \return The PTS diff
+   */
+  int64_t GetDemuxPTSDiff();
+
+  /*!
+   * \brief Get the number of ReadSampleAsync calls, to know if the reader has been advanced
+   * \return The number of samples requested
+   */
+  uint64_t GetReadSampleCount();
 
   void SetObserver(SampleReaderObserver* observer) { m_observer = observer; }
 
@@ -103,5 +164,31 @@ protected:
   SampleReaderObserver* m_observer{nullptr};
 
 private:
-  std::future<AP4_Result> m_readSampleAsyncState;
+  struct ReadySample
+  {
+    DemuxSample m_sample;
+    std::vector<AP4_Byte> m_data;
+  };
+
+  DemuxSample GetReaderSample() const;
+  void ReadWorker();
+  bool CanReadAhead();
+
+  std::thread m_readWorker;
+  std::mutex m_readMutex;
+  std::condition_variable m_readCv;
+  bool m_isReadRequested{false}; // The sample to be demuxed has been requested to the worker
+  bool m_isReading{false}; // The worker thread is reading a sample
+  bool m_isReadAheadPaused{false};
+  bool m_isReadAheadStopped{false}; // The last read has failed or reached the end of stream
+  bool m_isStopping{false};
+  uint64_t m_readSampleCount{0};
+  int64_t m_demuxPtsDiff{0}; // PTS diff of the last sample demuxed, while the next one is read
+
+  size_t m_readAheadDepth{1};
+  std::function<bool()> m_canReadAhead;
+  // Ring of the samples read ahead, m_ringCount samples from m_ringHead
+  std::vector<ReadySample> m_ring;
+  size_t m_ringHead{0};
+  size_t m_ringCount{0};
 };
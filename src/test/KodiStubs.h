@@ -10,7 +10,9 @@
 
  // Kodi interface stubs
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <map>
@@ -81,6 +83,8 @@ enum INPUTSTREAM_TYPE
   INPUTSTREAM_TYPE_ID3,
 };
 
+#define STREAM_NOPTS_VALUE 0xFFF0000000000000
+
 namespace kodi
 {
 namespace addon
@@ -195,18 +199,31 @@ public:
 
   bool OpenFileForWrite(const std::string& filename, bool overwrite = false) { return false; }
 
-  bool IsOpen() const { return false; }
-  void Close() {}
+  bool IsOpen() const { return m_isOpen; }
+  void Close() { m_isOpen = false; }
 
-  bool CURLCreate(const std::string& url) { return false; }
+  bool CURLCreate(const std::string& url) { return !testData.empty(); }
   bool CURLAddOption(CURLOptiontype type, const std::string& name, const std::string& value)
   {
-    return false;
+    return !testData.empty();
   }
 
-  bool CURLOpen(unsigned int flags = 0) { return false; }
+  bool CURLOpen(unsigned int flags = 0)
+  {
+    m_position = 0;
+    m_isOpen = !testData.empty();
+    return m_isOpen;
+  }
 
-  ssize_t Read(void* ptr, size_t size) { return 0; }
+  ssize_t Read(void* ptr, size_t size)
+  {
+    if (!m_isOpen)
+      return -1;
+    size = std::min(size, testData.size() - m_position);
+    std::memcpy(ptr, testData.data() + m_position, size);
+    m_position += size;
+    return static_cast<ssize_t>(size);
+  }
 
   bool ReadLine(std::string& line) { return false; }
 
@@ -222,7 +239,7 @@ public:
 
   int64_t GetLength() const { return 0; }
 
-  bool AtEnd() const { return true; }
+  bool AtEnd() const { return m_position >= testData.size(); }
 
   int GetChunkSize() const { return 0; }
 
@@ -236,6 +253,12 @@ public:
 
   const std::string GetPropertyValue(FilePropertyTypes type, const std::string& name) const
   {
+    if (!m_isOpen)
+      return "";
+    if (type == ADDON_FILE_PROPERTY_RESPONSE_PROTOCOL)
+      return "HTTP/1.1 200 OK";
+    if (type == ADDON_FILE_PROPERTY_RESPONSE_HEADER && name == "Content-Length")
+      return std::to_string(testData.size());
     return "";
   }
 
@@ -246,6 +269,13 @@ public:
   }
 
   double GetFileDownloadSpeed() const { return 0.0; }
+
+  // Test only, the response data of the CURL requests, when empty the requests fail
+  static inline std::vector<uint8_t> testData;
+
+private:
+  bool m_isOpen{false};
+  size_t m_position{0};
 };
 
 inline bool FileExists(const std::string& filename, bool usecache = false)
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/BufferBudget.h"
+
+#include <gtest/gtest.h>
+
+using namespace adaptive;
+
+class BufferBudgetTest : public ::testing::Test
+{
+};
+
+TEST_F(BufferBudgetTest, SingleClient)
+{
+  CBufferBudget budget(1000);
+
+  EXPECT_TRUE(budget.IsAvailable(1, 1000));
+  EXPECT_FALSE(budget.IsAvailable(1, 1001));
+
+  // The bytes already used by the client are not counted twice
+  budget.SetUsage(1, 800);
+  EXPECT_TRUE(budget.IsAvailable(1, 1000));
+  EXPECT_FALSE(budget.IsAvailable(1, 1200));
+}
+
+TEST_F(BufferBudgetTest, SharedBetweenClients)
+{
+  CBufferBudget budget(1000);
+
+  budget.SetUsage(1, 600);
+  EXPECT_TRUE(budget.IsAvailable(2, 400));
+  EXPECT_FALSE(budget.IsAvailable(2, 401));
+
+  budget.SetUsage(2, 400);
+  EXPECT_FALSE(budget.IsAvailable(1, 601));
+
+  // The client release part of its buffer
+  budget.SetUsage(1, 100);
+  EXPECT_TRUE(budget.IsAvailable(2, 900));
+  EXPECT_FALSE(budget.IsAvailable(2, 901));
+}
+
+TEST_F(BufferBudgetTest, RemoveClient)
+{
+  CBufferBudget budget(1000);
+
+  budget.SetUsage(1, 700);
+  budget.SetUsage(2, 300);
+  EXPECT_FALSE(budget.IsAvailable(3, 1));
+
+  budget.RemoveClient(1);
+  EXPECT_TRUE(budget.IsAvailable(3, 700));
+  EXPECT_FALSE(budget.IsAvailable(3, 701));
+
+  // Removing an unknown client has no effect
+  budget.RemoveClient(10);
+  EXPECT_FALSE(budget.IsAvailable(3, 701));
+}
+
+TEST_F(BufferBudgetTest, OverBudgetUsage)
+{
+  CBufferBudget budget(1000);
+
+  // The assured buffer of a stream can exceed the budget, the others are then blocked
+  budget.SetUsage(1, 1500);
+  EXPECT_FALSE(budget.IsAvailable(2, 1));
+  EXPECT_FALSE(budget.IsAvailable(1, 1500));
+
+  budget.SetUsage(1, 200);
+  EXPECT_TRUE(budget.IsAvailable(2, 800));
+}
@@ -0,0 +1,421 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../lib/mpegts/mpegts/byteScanner.h"
+#include "../../lib/mpegts/mpegts/tsDemuxer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace TSDemux;
+
+namespace
+{
+constexpr size_t PACKET_SIZE = 188;
+constexpr size_t SYNC_COUNT = 3;
+
+size_t FindByteScalar(const uint8_t* data, size_t size, uint8_t value)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (data[i] == value)
+      return i;
+  }
+  return size;
+}
+
+size_t FindStartCodeScalar(const std::vector<uint8_t>& data)
+{
+  for (size_t i = 0; i + 3 <= data.size(); ++i)
+  {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+      return i;
+  }
+  return data.size();
+}
+
+size_t FindPacketSyncScalar(const std::vector<uint8_t>& data, size_t packetSize, size_t syncCount)
+{
+  for (size_t offset = 0; offset + (syncCount - 1) * packetSize < data.size(); ++offset)
+  {
+    size_t count = 0;
+    while (count < syncCount && data[offset + count * packetSize] == TS_SYNC_BYTE)
+      ++count;
+    if (count == syncCount)
+      return offset;
+  }
+  return data.size();
+}
+
+// Append TS packets with random payload, the payload can contain sync byte values
+void AppendPackets(std::vector<uint8_t>& data,
+                   size_t count,
+                   std::mt19937& rng,
+                   size_t packetSize = PACKET_SIZE)
+{
+  std::uniform_int_distribution<int> byteDist(0, 255);
+  for (size_t i = 0; i < count; ++i)
+  {
+    data.emplace_back(TS_SYNC_BYTE);
+    for (size_t n = 1; n < packetSize; ++n)
+      data.emplace_back(static_cast<uint8_t>(byteDist(rng)));
+  }
+}
+
+void AppendGarbage(std::vector<uint8_t>& data, size_t size, std::mt19937& rng)
+{
+  std::uniform_int_distribution<int> byteDist(0, 255);
+  for (size_t n = 0; n < size; ++n)
+    data.emplace_back(static_cast<uint8_t>(byteDist(rng)));
+}
+
+// Damaged TS inputs, as seen on discontinuous live streams
+enum class Damage
+{
+  LEADING_GARBAGE, // Stream joined in the middle of a packet
+  TRUNCATED_PACKET, // Packet cut by a failover, then the packets of another source
+  FAKE_SYNC_PAYLOAD, // Payload filled with sync byte values at packet stride
+  CORRUPTED_SYNC, // Sync bytes damaged by bit flips
+};
+
+std::vector<uint8_t> CreateDamagedInput(Damage damage, std::mt19937& rng)
+{
+  std::vector<uint8_t> data;
+  std::uniform_int_distribution<size_t> sizeDist(1, 4 * PACKET_SIZE);
+
+  switch (damage)
+  {
+    case Damage::LEADING_GARBAGE:
+      AppendGarbage(data, sizeDist(rng), rng);
+      AppendPackets(data, 8, rng);
+      break;
+    case Damage::TRUNCATED_PACKET:
+    {
+      AppendPackets(data, 2, rng);
+      data.resize(data.size() - sizeDist(rng) % PACKET_SIZE - 1);
+      AppendPackets(data, 8, rng);
+      break;
+    }
+    case Damage::FAKE_SYNC_PAYLOAD:
+    {
+      std::vector<uint8_t> fake(PACKET_SIZE * 2 + 1, 0);
+      fake[0] = TS_SYNC_BYTE;
+      fake[PACKET_SIZE] = TS_SYNC_BYTE;
+      AppendGarbage(data, sizeDist(rng), rng);
+      data.insert(data.end(), fake.begin(), fake.end());
+      AppendPackets(data, 8, rng);
+      break;
+    }
+    case Damage::CORRUPTED_SYNC:
+    {
+      AppendPackets(data, 12, rng);
+      std::uniform_int_distribution<size_t> packetDist(0, 11);
+      std::uniform_int_distribution<int> bitDist(0, 7);
+      for (int n = 0; n < 4; ++n)
+        data[packetDist(rng) * PACKET_SIZE] ^= static_cast<uint8_t>(1 << bitDist(rng));
+      break;
+    }
+  }
+  return data;
+}
+
+// Serve the TS data from memory, as the TS reader does from the segment buffer
+class CMemoryDemuxer : public TSDemuxer
+{
+public:
+  explicit CMemoryDemuxer(const std::vector<uint8_t>& data) : m_data(data) {}
+
+  bool ReadAV(uint64_t pos, unsigned char* buffer, size_t len) override
+  {
+    if (pos + len > m_data.size())
+      return false;
+    std::memcpy(buffer, m_data.data() + pos, len);
+    return true;
+  }
+
+private:
+  const std::vector<uint8_t>& m_data;
+};
+
+// Get the positions of the packets found by the demuxer, until the end of the data
+std::vector<uint64_t> DemuxPackets(const std::vector<uint8_t>& data,
+                                   size_t& packetSize,
+                                   int& result)
+{
+  CMemoryDemuxer demuxer(data);
+  AVContext context(&demuxer, 0, 0);
+  std::vector<uint64_t> positions;
+
+  while ((result = context.TSResync()) == AVCONTEXT_CONTINUE)
+  {
+    positions.emplace_back(context.GetPosition());
+    context.GoNext();
+  }
+  packetSize = context.GetPacketSize();
+  return positions;
+}
+} // unnamed namespace
+
+class ByteScannerTest : public ::testing::Test
+{
+};
+
+TEST_F(ByteScannerTest, FindByteAllPositions)
+{
+  // Cover the vector loop, the scalar tail and the unaligned starts
+  for (size_t size = 0; size < 80; ++size)
+  {
+    std::vector<uint8_t> data(size + 3, 0);
+    for (size_t start = 0; start < 3; ++start)
+    {
+      EXPECT_EQ(FindByte(data.data() + start, size, TS_SYNC_BYTE), size);
+      for (size_t pos = 0; pos < size; ++pos)
+      {
+        data[start + pos] = TS_SYNC_BYTE;
+        EXPECT_EQ(FindByte(data.data() + start, size, TS_SYNC_BYTE), pos);
+        data[start + pos] = 0;
+      }
+    }
+  }
+}
+
+TEST_F(ByteScannerTest, FindPacketSyncCleanStream)
+{
+  std::mt19937 rng(1);
+  std::vector<uint8_t> data;
+  AppendPackets(data, 4, rng);
+
+  EXPECT_EQ(FindPacketSync(data.data(), data.size(), PACKET_SIZE, SYNC_COUNT), 0);
+  // Not enough packets in the buffer to validate the stride
+  EXPECT_EQ(FindPacketSync(data.data(), PACKET_SIZE * 2, PACKET_SIZE, SYNC_COUNT),
+            PACKET_SIZE * 2);
+}
+
+TEST_F(ByteScannerTest, FindPacketSyncSkipFakeSync)
+{
+  std::vector<uint8_t> data(PACKET_SIZE * 6, 0);
+  // A single sync byte value in the payload
+  data[10] = TS_SYNC_BYTE;
+  data[10 + PACKET_SIZE] = TS_SYNC_BYTE;
+  for (size_t pos = 50; pos < data.size(); pos += PACKET_SIZE)
+    data[pos] = TS_SYNC_BYTE;
+
+  EXPECT_EQ(FindPacketSync(data.data(), data.size(), PACKET_SIZE, SYNC_COUNT), 50);
+}
+
+TEST_F(ByteScannerTest, DamagedInputCorpus)
+{
+  std::mt19937 rng(20231018);
+  const Damage damages[] = {Damage::LEADING_GARBAGE, Damage::TRUNCATED_PACKET,
+                            Damage::FAKE_SYNC_PAYLOAD, Damage::CORRUPTED_SYNC};
+
+  for (Damage damage : damages)
+  {
+    for (int n = 0; n < 300; ++n)
+    {
+      const std::vector<uint8_t> data = CreateDamagedInput(damage, rng);
+      const size_t expected = FindPacketSyncScalar(data, PACKET_SIZE, SYNC_COUNT);
+
+      ASSERT_EQ(FindPacketSync(data.data(), data.size(), PACKET_SIZE, SYNC_COUNT), expected)
+          << "damage " << static_cast<int>(damage) << " input " << n;
+      ASSERT_EQ(FindByte(data.data(), data.size(), TS_SYNC_BYTE),
+                FindByteScalar(data.data(), data.size(), TS_SYNC_BYTE));
+      // There is always a valid sequence of packets after the damage
+      if (damage != Damage::CORRUPTED_SYNC)
+      {
+        ASSERT_LT(expected, data.size());
+      }
+    }
+  }
+}
+
+TEST_F(ByteScannerTest, FindStartCodeAllPositions)
+{
+  for (size_t size = 0; size < 80; ++size)
+  {
+    std::vector<uint8_t> data(size, 0xFF);
+    EXPECT_EQ(FindStartCode(data.data(), size), size);
+    for (size_t pos = 0; pos + 3 <= size; ++pos)
+    {
+      data[pos] = 0;
+      data[pos + 1] = 0;
+      data[pos + 2] = 1;
+      EXPECT_EQ(FindStartCode(data.data(), size), pos);
+      data[pos] = data[pos + 1] = data[pos + 2] = 0xFF;
+    }
+    // A start code split at the buffer end is not found
+    if (size >= 2)
+    {
+      data[size - 2] = 0;
+      data[size - 1] = 0;
+      EXPECT_EQ(FindStartCode(data.data(), size), size);
+    }
+  }
+}
+
+TEST_F(ByteScannerTest, FindStartCodeRandomInput)
+{
+  // Zero runs longer than the prefix, as with the four bytes start codes
+  std::mt19937 rng(20231019);
+  std::uniform_int_distribution<int> byteDist(0, 255);
+  std::uniform_int_distribution<int> kindDist(0, 9);
+
+  for (int n = 0; n < 500; ++n)
+  {
+    std::vector<uint8_t> data(byteDist(rng) * 4);
+    for (uint8_t& value : data)
+    {
+      const int kind = kindDist(rng);
+      value = kind < 5 ? 0 : (kind < 7 ? 1 : static_cast<uint8_t>(byteDist(rng)));
+    }
+
+    size_t offset = 0;
+    while (offset <= data.size())
+    {
+      const std::vector<uint8_t> tail(data.begin() + offset, data.end());
+      const size_t found = FindStartCode(tail.data(), tail.size());
+      ASSERT_EQ(found, FindStartCodeScalar(tail)) << "input " << n << " offset " << offset;
+      offset += found + 1;
+    }
+  }
+}
+
+TEST_F(ByteScannerTest, FindStartCodeBenchmark)
+{
+  // Compare the scan of a video payload with the rolling register used by the parsers
+  // before, the times are reported as test properties, e.g. with --gtest_output=xml
+  constexpr size_t PAYLOAD_SIZE = 16 * 1024 * 1024;
+  constexpr int RUNS = 4;
+  std::mt19937 rng(20231022);
+  std::uniform_int_distribution<int> byteDist(0, 255);
+
+  // Random slice data with a start code every 4 KiB, as a high bitrate stream
+  std::vector<uint8_t> data(PAYLOAD_SIZE);
+  for (uint8_t& value : data)
+    value = static_cast<uint8_t>(byteDist(rng));
+  for (size_t pos = 0; pos + 3 <= data.size(); pos += 4096)
+  {
+    data[pos] = 0;
+    data[pos + 1] = 0;
+    data[pos + 2] = 1;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration registerTime{Clock::duration::max()};
+  Clock::duration scannerTime{Clock::duration::max()};
+  size_t registerCount{0};
+  size_t scannerCount{0};
+
+  for (int run = 0; run < RUNS; ++run)
+  {
+    Clock::time_point start = Clock::now();
+    uint32_t startCode = 0xFFFFFFFF;
+    registerCount = 0;
+    for (uint8_t value : data)
+    {
+      startCode = (startCode << 8) | value;
+      if ((startCode & 0x00FFFFFF) == 0x000001)
+        registerCount++;
+    }
+    registerTime = std::min(registerTime, Clock::now() - start);
+
+    start = Clock::now();
+    scannerCount = 0;
+    for (size_t pos = 0; pos < data.size();)
+    {
+      const size_t found = FindStartCode(data.data() + pos, data.size() - pos);
+      if (found == data.size() - pos)
+        break;
+      scannerCount++;
+      pos += found + 3;
+    }
+    scannerTime = std::min(scannerTime, Clock::now() - start);
+  }
+
+  EXPECT_EQ(scannerCount, registerCount);
+
+  const auto toMicroseconds = [](Clock::duration duration) {
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+  };
+  RecordProperty("RegisterScanUs", toMicroseconds(registerTime));
+  RecordProperty("FindStartCodeUs", toMicroseconds(scannerTime));
+}
+
+TEST_F(ByteScannerTest, DemuxDamagedInputCorpus)
+{
+  // Packets appended to the damaged inputs, enough to fill the resync window
+  constexpr size_t TAIL_PACKETS = 40;
+  std::mt19937 rng(20231020);
+  const Damage damages[] = {Damage::LEADING_GARBAGE, Damage::TRUNCATED_PACKET,
+                            Damage::FAKE_SYNC_PAYLOAD, Damage::CORRUPTED_SYNC};
+
+  for (Damage damage : damages)
+  {
+    for (int n = 0; n < 50; ++n)
+    {
+      std::vector<uint8_t> data = CreateDamagedInput(damage, rng);
+      AppendPackets(data, TAIL_PACKETS, rng);
+      const uint64_t tailPos = data.size() - TAIL_PACKETS * PACKET_SIZE;
+
+      size_t packetSize;
+      int result;
+      const std::vector<uint64_t> positions = DemuxPackets(data, packetSize, result);
+
+      ASSERT_EQ(packetSize, PACKET_SIZE) << "damage " << static_cast<int>(damage) << " input " << n;
+      // The demuxer stops only at the end of the data
+      ASSERT_EQ(result, AVCONTEXT_IO_ERROR);
+
+      // After the damage the demuxer is aligned, all the packets are found
+      const auto tailIt = std::lower_bound(positions.begin(), positions.end(), tailPos);
+      ASSERT_EQ(static_cast<size_t>(positions.end() - tailIt), TAIL_PACKETS)
+          << "damage " << static_cast<int>(damage) << " input " << n;
+      for (size_t i = 0; i < TAIL_PACKETS; ++i)
+        ASSERT_EQ(tailIt[i], tailPos + i * PACKET_SIZE);
+    }
+  }
+}
+
+TEST_F(ByteScannerTest, DemuxPacketSizes)
+{
+  // The packet size is detected also after leading garbage, e.g. M2TS and DVB-ASI packets
+  const size_t packetSizes[] = {FLUTS_NORMAL_TS_PACKETSIZE, FLUTS_M2TS_TS_PACKETSIZE,
+                                FLUTS_DVB_ASI_TS_PACKETSIZE};
+  const size_t garbageSizes[] = {0, 1, 100, 500};
+  std::mt19937 rng(20231021);
+
+  for (size_t size : packetSizes)
+  {
+    for (size_t garbageSize : garbageSizes)
+    {
+      std::vector<uint8_t> data;
+      AppendGarbage(data, garbageSize, rng);
+      // Keep the garbage free of sync bytes, the packet size could be ambiguous
+      std::replace(data.begin(), data.end(), static_cast<uint8_t>(TS_SYNC_BYTE), static_cast<uint8_t>(0));
+      AppendPackets(data, 40, rng, size);
+      // A packet with a damaged sync byte
+      data[garbageSize + 5 * size] = 0x46;
+
+      size_t packetSize;
+      int result;
+      const std::vector<uint64_t> positions = DemuxPackets(data, packetSize, result);
+
+      ASSERT_EQ(packetSize, size) << "garbage " << garbageSize;
+      EXPECT_EQ(result, AVCONTEXT_IO_ERROR);
+      ASSERT_FALSE(positions.empty());
+      EXPECT_EQ(positions.front(), garbageSize);
+      EXPECT_EQ(positions.back(), data.size() - size);
+      for (uint64_t pos : positions)
+        EXPECT_EQ((pos - garbageSize) % size, 0) << "garbage " << garbageSize;
+    }
+  }
+}
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/AdaptationSet.h"
+#include "../common/ChooserBufferBased.h"
+#include "../common/Representation.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+using namespace CHOOSER;
+using namespace PLAYLIST;
+
+namespace
+{
+// Bandwidths of the video representations, in bit/s
+constexpr uint32_t BANDWIDTHS[] = {1000000, 2000000, 4000000, 8000000};
+
+// With a max buffer of 100 secs the reservoir is 20 secs and the cushion 90 secs,
+// so the bandwidth is mapped linearly as 1 Mbit/s + (level - 20) * 0.1 Mbit/s
+constexpr double MAX_LEVEL_SECS = 100;
+} // unnamed namespace
+
+class ChooserBufferBasedTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    m_adp.SetStreamType(StreamType::VIDEO);
+    for (uint32_t bandwidth : BANDWIDTHS)
+    {
+      auto rep = std::make_unique<CRepresentation>(&m_adp);
+      rep->SetId(std::to_string(bandwidth));
+      rep->SetBandwidth(bandwidth);
+      rep->SetResWidth(1280);
+      rep->SetResHeight(720);
+      m_adp.AddRepresentation(rep);
+    }
+
+    m_chooser.SetScreenResolution(1920, 1080, 1920, 1080);
+    m_chooser.PostInit();
+  }
+
+  CRepresentation* GetRep(size_t index) { return m_adp.GetRepresentations()[index].get(); }
+
+  // Get the next representation with the buffer at the level specified
+  CRepresentation* ChooseAtLevel(double levelSecs, CRepresentation* currentRep)
+  {
+    m_chooser.SetBufferStatus(StreamType::VIDEO, {levelSecs, MAX_LEVEL_SECS});
+    return m_chooser.GetNextRepresentation(&m_adp, currentRep);
+  }
+
+  CAdaptationSet m_adp;
+  CRepresentationChooserBufferBased m_chooser;
+};
+
+TEST_F(ChooserBufferBasedTest, ReservoirAndCushion)
+{
+  // Under the reservoir the lowest representation is used, over the cushion the highest
+  EXPECT_EQ(ChooseAtLevel(0, GetRep(3)), GetRep(0));
+  EXPECT_EQ(ChooseAtLevel(20, GetRep(2)), GetRep(0));
+  EXPECT_EQ(ChooseAtLevel(90, GetRep(0)), GetRep(3));
+  EXPECT_EQ(ChooseAtLevel(100, GetRep(1)), GetRep(3));
+}
+
+TEST_F(ChooserBufferBasedTest, RateMapStepUp)
+{
+  // 2 Mbit/s is mapped to 30 secs, 4 Mbit/s to 50 secs
+  EXPECT_EQ(ChooseAtLevel(29, GetRep(0)), GetRep(0));
+  EXPECT_EQ(ChooseAtLevel(31, GetRep(0)), GetRep(1));
+  EXPECT_EQ(ChooseAtLevel(49, GetRep(1)), GetRep(1));
+  EXPECT_EQ(ChooseAtLevel(51, GetRep(1)), GetRep(2));
+  // A fast buffer growth can skip representations
+  EXPECT_EQ(ChooseAtLevel(60, GetRep(0)), GetRep(2));
+}
+
+TEST_F(ChooserBufferBasedTest, RateMapHysteresis)
+{
+  // Between the adjacent representations the current one is kept
+  EXPECT_EQ(ChooseAtLevel(40, GetRep(1)), GetRep(1));
+  EXPECT_EQ(ChooseAtLevel(40, GetRep(2)), GetRep(2));
+  EXPECT_EQ(ChooseAtLevel(31, GetRep(2)), GetRep(2));
+  // Step down when the mapped bandwidth reach the lower representation,
+  // to the lowest one that is not under the mapped bandwidth
+  EXPECT_EQ(ChooseAtLevel(29, GetRep(2)), GetRep(1));
+  EXPECT_EQ(ChooseAtLevel(25, GetRep(3)), GetRep(1));
+  EXPECT_EQ(ChooseAtLevel(21, GetRep(3)), GetRep(1));
+}
+
+TEST_F(ChooserBufferBasedTest, OtherStreamStatusIgnored)
+{
+  // The buffer status of the audio stream must not drive the video quality
+  m_chooser.SetBufferStatus(StreamType::VIDEO, {0, MAX_LEVEL_SECS});
+  m_chooser.SetBufferStatus(StreamType::AUDIO, {MAX_LEVEL_SECS, MAX_LEVEL_SECS});
+  EXPECT_EQ(m_chooser.GetNextRepresentation(&m_adp, GetRep(2)), GetRep(0));
+}
@@ -8,15 +8,139 @@
 
 #include "TestHelper.h"
 
+#include "../common/SegmentBufferPool.h"
 #include "../utils/Base64Utils.h"
 #include "../utils/PropertiesUtils.h"
 #include "../utils/UrlUtils.h"
 #include "../utils/Utils.h"
+#include "../../lib/mpegts/mpegts/byteScanner.h"
+#include "../../lib/mpegts/mpegts/tsDemuxer.h"
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cstring>
+#include <thread>
+
 using namespace UTILS;
 
+namespace
+{
+// Read each TS packet with a seek and a read of the stream, as TSReader did before the view
+class CStreamDemuxer : public TSDemux::TSDemuxer
+{
+public:
+  explicit CStreamDemuxer(adaptive::AdaptiveStream& stream) : m_stream(stream) {}
+
+  bool ReadAV(uint64_t pos, unsigned char* data, size_t len) override
+  {
+    m_stream.seek(pos);
+    if (m_stream.read(data, static_cast<uint32_t>(len)) != len)
+      return false;
+    m_checksum += data[len - 1];
+    return true;
+  }
+
+  uint64_t m_checksum{0};
+
+protected:
+  adaptive::AdaptiveStream& m_stream;
+};
+
+// Read the sequential TS packets from a view of the segment buffer, as TSReader::ReadAV
+class CWindowDemuxer : public CStreamDemuxer
+{
+public:
+  explicit CWindowDemuxer(adaptive::AdaptiveStream& stream) : CStreamDemuxer(stream) {}
+
+  bool ReadAV(uint64_t pos, unsigned char* data, size_t len) override
+  {
+    if (pos == m_streamPos)
+    {
+      if (pos < m_windowPos || pos + len > m_windowPos + m_windowSize)
+      {
+        if (m_stream.PeekView(m_windowData, m_windowSize))
+          m_windowPos = pos;
+        else
+          m_windowSize = 0;
+      }
+
+      if (pos >= m_windowPos && pos + len <= m_windowPos + m_windowSize &&
+          m_stream.SkipView(len))
+      {
+        std::memcpy(data, m_windowData + (pos - m_windowPos), len);
+        m_streamPos = pos + len;
+        m_checksum += data[len - 1];
+        return true;
+      }
+    }
+
+    if (pos != m_streamPos)
+      m_stream.seek(pos);
+
+    if (m_stream.read(data, static_cast<uint32_t>(len)) != len)
+    {
+      m_streamPos = ~0ULL;
+      return false;
+    }
+    m_streamPos = pos + len;
+    m_checksum += data[len - 1];
+    return true;
+  }
+
+private:
+  uint64_t m_streamPos{~0ULL};
+  const uint8_t* m_windowData{nullptr};
+  uint64_t m_windowPos{0};
+  size_t m_windowSize{0};
+};
+
+// Read the ADTS frames and copy each payload to a demux packet, as done by ADTSReader.
+// The payload can be read from a view of the segment buffer, as ADTSFrame::ReadFrameData
+// does, otherwise it is read to the frame buffer before being copied to the packet
+class CAdtsDemuxer
+{
+public:
+  CAdtsDemuxer(adaptive::AdaptiveStream& stream, bool isViewAllowed)
+    : m_stream(stream), m_isViewAllowed(isViewAllowed)
+  {
+  }
+
+  bool DemuxRead()
+  {
+    uint8_t header[7];
+    if (m_stream.read(header, sizeof(header)) != sizeof(header))
+      return false;
+
+    const uint32_t frameSize =
+        (((header[3] & 0x03) << 11) | (header[4] << 3) | (header[5] >> 5)) - sizeof(header);
+    const uint8_t* frameData{nullptr};
+
+    if (!m_isViewAllowed || !m_stream.ReadView(frameSize, frameData))
+    {
+      m_frameBuffer.resize(frameSize);
+      if (m_stream.read(m_frameBuffer.data(), frameSize) != frameSize)
+        return false;
+      frameData = m_frameBuffer.data();
+    }
+
+    std::memcpy(m_packet.data(), frameData, frameSize);
+    m_checksum += m_packet[frameSize - 1];
+    m_bytes += sizeof(header) + frameSize;
+    return true;
+  }
+
+  uint64_t m_checksum{0};
+  uint64_t m_bytes{0};
+
+private:
+  adaptive::AdaptiveStream& m_stream;
+  bool m_isViewAllowed;
+  std::vector<uint8_t> m_frameBuffer;
+  std::vector<uint8_t> m_packet = std::vector<uint8_t>(8192);
+};
+} // unnamed namespace
+
 class DASHTreeTest : public ::testing::Test
 {
 protected:
@@ -269,6 +393,29 @@ TEST_F(DASHTreeTest, CalculateCorrectSegmentNumbersFromSegmentTimeline)
   EXPECT_EQ(segments.Get(12)->m_number, 487062);
 }
 
+TEST_F(DASHTreeTest, ConstSegmentTimelineAccessDontCopy)
+{
+  OpenTestFile("mpd/segtimeline_live_ast.mpd");
+
+  const PLAYLIST::CRepresentation* repr =
+      tree->m_periods[0]->GetAdaptationSets()[0]->GetRepresentations()[0].get();
+
+  testHelper::allocationsCount = 0;
+  testHelper::isCountAllocations = true;
+
+  const size_t size = repr->SegmentTimeline().GetSize();
+  const PLAYLIST::CSegment* segment = repr->SegmentTimeline().Get(size - 1);
+  const size_t pos = repr->get_segment_pos(segment);
+  const bool hasSegTemplate = repr->GetSegmentTemplate().has_value();
+
+  testHelper::isCountAllocations = false;
+
+  EXPECT_EQ(testHelper::allocationsCount, 0);
+  EXPECT_EQ(size, 13);
+  EXPECT_EQ(pos, 12);
+  EXPECT_TRUE(hasSegTemplate);
+}
+
 TEST_F(DASHTreeTest, CalculateCorrectSegmentNumbersFromSegmentTemplateWithPTO)
 {
   tree->SetNowTime(1617223929L);
@@ -513,6 +660,35 @@ TEST_F(DASHTreeTest, CalculateMultipleSegTpl)
   EXPECT_EQ(adpSets[2]->GetRepresentations()[0]->SegmentTimeline().Get(0)->m_number, 5);
 }
 
+TEST_F(DASHTreeTest, SegmentTimelineMemory)
+{
+  OpenTestFile("mpd/segtpl_multiperiod.mpd", "https://foo.bar/dash/multiperiod.mpd");
+  ASSERT_EQ(tree->m_periods.size(), 3);
+
+  size_t segments{0};
+  size_t timelineBytes{0};
+  for (auto& period : tree->m_periods)
+  {
+    for (auto& adpSet : period->GetAdaptationSets())
+    {
+      for (auto& repr : adpSet->GetRepresentations())
+      {
+        const std::vector<PLAYLIST::CSegment>& data = repr->SegmentTimeline().GetData();
+        // The capacity reserved from the estimated count must not be far from the real count
+        EXPECT_LE(data.capacity() - data.size(), data.size() / 4);
+        segments += data.size();
+        timelineBytes += data.capacity() * sizeof(PLAYLIST::CSegment);
+      }
+    }
+  }
+
+  // 1800 segments of 2 secs for each templated representation, 901 for the timeline
+  EXPECT_EQ(segments, 6 * 1800 + 901);
+  // The 16 bit pssh set and the initialization flag share the last 64 bit slot
+  EXPECT_LE(sizeof(PLAYLIST::CSegment), 7 * sizeof(uint64_t) + sizeof(std::string));
+  EXPECT_LE(timelineBytes, (segments + segments / 4) * sizeof(PLAYLIST::CSegment));
+}
+
 TEST_F(DASHTreeAdaptiveStreamTest, CalculateRedirectSegTpl)
 {
   testHelper::effectiveUrl = "https://foo.bar/mpd/stream.mpd";
@@ -610,6 +786,347 @@ TEST_F(DASHTreeAdaptiveStreamTest, MisalignedSegmentTimeline)
   EXPECT_EQ(tree->m_currentPeriod->GetAdaptationSets()[1]->GetRepresentations()[0]->GetStartNumber(), 5);
 }
 
+TEST_F(DASHTreeTest, LiveUpdateMultiPeriodTiming)
+{
+  // Update of a live manifest with 10 periods of 40 representations, that add 3 segments
+  // to the last period. The full parse of the update manifest is timed apart from the
+  // refresh, that also merge it, the times are reported as test properties
+  constexpr int RUNS = 10;
+  OpenTestFile("mpd/live_multiperiod.mpd", "https://foo.bar/live.mpd");
+  ASSERT_EQ(tree->m_periods.size(), 10);
+
+  UTILS::CURL::HTTPResponse resp;
+  testHelper::testFile = "mpd/live_multiperiod_upd.mpd";
+  ASSERT_TRUE(testHelper::DownloadFile("https://foo.bar/live.mpd", {}, {}, resp));
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration parseTime{Clock::duration::max()};
+  Clock::duration refreshTime{Clock::duration::max()};
+
+  for (int run = 0; run < RUNS; ++run)
+  {
+    DASHTestTree parseTree;
+    parseTree.Configure(m_kodiProps, m_reprChooser, "urn:uuid:EDEF8BA9-79D6-4ACE-A3C8-27DCD51D21ED",
+                        "");
+    Clock::time_point start = Clock::now();
+    ASSERT_TRUE(parseTree.Open(resp.effectiveUrl, resp.headers, resp.data));
+    parseTime = std::min(parseTime, Clock::now() - start);
+    parseTree.Uninitialize();
+
+    start = Clock::now();
+    tree->RunManifestUpdate("mpd/live_multiperiod_upd.mpd");
+    refreshTime = std::min(refreshTime, Clock::now() - start);
+  }
+
+  size_t representations{0};
+  for (auto& adpSet : tree->m_periods.back()->GetAdaptationSets())
+  {
+    for (auto& repr : adpSet->GetRepresentations())
+    {
+      EXPECT_EQ(repr->SegmentTimeline().GetSize(), 33);
+      representations++;
+    }
+  }
+  EXPECT_EQ(tree->m_periods.size(), 10);
+  EXPECT_EQ(representations, 40);
+
+  const auto toMicroseconds = [](Clock::duration duration) {
+    return static_cast<int>(std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+  };
+  RecordProperty("ParseUpdateUs", toMicroseconds(parseTime));
+  RecordProperty("RefreshUpdateUs", toMicroseconds(refreshTime));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, ReadWhileBufferReallocating)
+{
+  // The reader copy the committed data without lock while the download worker write
+  // the next chunks, and reallocates the buffer memory for each one of them
+  OpenTestFile("mpd/segtpl.mpd", "https://foo.bar/mpd/test.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+
+  constexpr size_t segmentSize = 64 * 1024;
+  testStream->SetInPlaceDownload(segmentSize, 4096);
+  testStream->start_stream();
+
+  uint8_t data[16];
+  size_t readIndex = 0;
+  size_t wrongBytes = 0;
+  uint64_t prevSegmentNumber = 0;
+
+  for (int segment = 0; segment < 8; ++segment)
+  {
+    uint64_t segmentNumber;
+    ASSERT_EQ(testStream->read(&segmentNumber, sizeof(segmentNumber)), sizeof(segmentNumber));
+    // The first segment is the initialization one
+    if (segment > 1)
+      EXPECT_EQ(segmentNumber, prevSegmentNumber + 1);
+    prevSegmentNumber = segmentNumber;
+
+    // Read sizes that vary and never cross the end of the segment
+    for (size_t pos = sizeof(segmentNumber); pos < segmentSize;)
+    {
+      const uint32_t size =
+          static_cast<uint32_t>(std::min(1 + (readIndex++ * 37) % sizeof(data), segmentSize - pos));
+      ASSERT_EQ(testStream->read(data, size), size);
+      // Let the worker run also with a single CPU core
+      std::this_thread::yield();
+
+      for (uint32_t i = 0; i < size; ++i)
+      {
+        if (data[i] != TestAdaptiveStream::GetInPlaceByte(segmentNumber, pos + i))
+          wrongBytes++;
+      }
+      pos += size;
+    }
+  }
+
+  EXPECT_EQ(wrongBytes, 0);
+  EXPECT_GT(testStream->GetLockFreeReads(), 0);
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, DemuxTSFromSegmentView)
+{
+  // Demux TS segments reading the sequential packets from a view of the segment buffer,
+  // compared with a seek and a read of the stream for each packet. The packets per second
+  // are reported as test properties, e.g. with --gtest_output=xml
+  constexpr size_t PACKET_SIZE = 188;
+  constexpr size_t SEGMENT_PACKETS = 2000;
+  constexpr size_t PACKETS = SEGMENT_PACKETS * 8;
+  constexpr int RUNS = 3;
+  OpenTestFile("mpd/segtpl.mpd", "https://foo.bar/mpd/test.mpd");
+
+  // Packets of a single PID, also the initialization segment has the same packets
+  std::vector<uint8_t> segmentData(SEGMENT_PACKETS * PACKET_SIZE);
+  for (size_t packet = 0; packet < SEGMENT_PACKETS; ++packet)
+  {
+    uint8_t* data = segmentData.data() + packet * PACKET_SIZE;
+    data[0] = TS_SYNC_BYTE;
+    data[1] = 0x01;
+    data[2] = 0x00;
+    data[3] = static_cast<uint8_t>(0x10 | (packet & 0x0f));
+    for (size_t pos = 4; pos < PACKET_SIZE; ++pos)
+      data[pos] = static_cast<uint8_t>(packet * 7 + pos);
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const auto demux = [&](CStreamDemuxer& demuxer, size_t& packets) {
+    TSDemux::AVContext context(&demuxer, 0, 0);
+    const Clock::time_point start = Clock::now();
+    packets = 0;
+    while (packets < PACKETS && context.TSResync() == TSDemux::AVCONTEXT_CONTINUE)
+    {
+      context.ProcessTSPacket();
+      context.GoNext();
+      packets++;
+    }
+    return Clock::now() - start;
+  };
+
+  Clock::duration streamTime{Clock::duration::max()};
+  Clock::duration windowTime{Clock::duration::max()};
+  uint64_t viewReads{0};
+
+  for (int run = 0; run < RUNS; ++run)
+  {
+    size_t streamPackets;
+    SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+    testStream->SetSegmentData(segmentData, 64 * 1024);
+    testStream->start_stream();
+    CStreamDemuxer streamDemuxer(*testStream);
+    streamTime = std::min(streamTime, demux(streamDemuxer, streamPackets));
+
+    size_t windowPackets;
+    SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+    testStream->SetSegmentData(segmentData, 64 * 1024);
+    testStream->start_stream();
+    CWindowDemuxer windowDemuxer(*testStream);
+    windowTime = std::min(windowTime, demux(windowDemuxer, windowPackets));
+    viewReads = testStream->GetViewReads();
+
+    ASSERT_EQ(streamPackets, PACKETS);
+    ASSERT_EQ(windowPackets, PACKETS);
+    EXPECT_EQ(windowDemuxer.m_checksum, streamDemuxer.m_checksum);
+  }
+
+  // Only the packets of a segment still in download are read from the stream, how many
+  // depends on the threads scheduling
+  EXPECT_GT(viewReads, 0);
+
+  const auto toPacketsPerSecond = [](Clock::duration duration) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return static_cast<int>(PACKETS * 1000000 / std::max<decltype(us)>(us, 1));
+  };
+  RecordProperty("SeekReadPacketsPerSec", toPacketsPerSecond(streamTime));
+  RecordProperty("ViewPacketsPerSec", toPacketsPerSecond(windowTime));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, DemuxADTSFromSegmentView)
+{
+  // Demux ADTS frames reading the payloads from a view of the segment buffer, compared with
+  // the payloads read to a frame buffer. The MiB per second are reported as test properties,
+  // e.g. with --gtest_output=xml
+  constexpr size_t SEGMENT_SIZE = 4 * 1024 * 1024;
+  constexpr size_t SEGMENTS = 4;
+  constexpr uint64_t DEMUX_BYTES = (SEGMENTS + 1) * SEGMENT_SIZE;
+  constexpr int RUNS = 3;
+  OpenTestFile("mpd/segtpl.mpd", "https://foo.bar/mpd/test.mpd");
+
+  // Segments of whole AAC frames, also the initialization segment has the same frames
+  std::vector<uint8_t> segmentData(SEGMENT_SIZE);
+  for (size_t pos = 0, frame = 0; pos < SEGMENT_SIZE; ++frame)
+  {
+    size_t frameSize = 300 + (frame * 37) % 400;
+    if (SEGMENT_SIZE - pos < frameSize + 300)
+      frameSize = SEGMENT_SIZE - pos;
+
+    uint8_t* data = segmentData.data() + pos;
+    data[0] = 0xFF;
+    data[1] = 0xF1;
+    data[2] = 0x50;
+    data[3] = static_cast<uint8_t>(0x80 | ((frameSize >> 11) & 0x03));
+    data[4] = static_cast<uint8_t>(frameSize >> 3);
+    data[5] = static_cast<uint8_t>(((frameSize & 0x07) << 5) | 0x1F);
+    data[6] = 0xFC;
+    for (size_t i = 7; i < frameSize; ++i)
+      data[i] = static_cast<uint8_t>(frame * 7 + i);
+    pos += frameSize;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  const auto demux = [&](CAdtsDemuxer& demuxer) {
+    const Clock::time_point start = Clock::now();
+    while (demuxer.m_bytes < DEMUX_BYTES && demuxer.DemuxRead())
+    {
+    }
+    return Clock::now() - start;
+  };
+
+  // The segment buffers memory is recycled by the pool as in a session, also when
+  // it is detached from a segment buffer to keep a view valid
+  adaptive::CSegmentBufferPool pool(64 * 1024 * 1024);
+  Clock::duration readTime{Clock::duration::max()};
+  Clock::duration viewTime{Clock::duration::max()};
+  uint64_t viewReads{0};
+
+  for (int run = 0; run < RUNS; ++run)
+  {
+    SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+    testStream->SetSegmentBufferPool(&pool);
+    testStream->SetSegmentData(segmentData, 64 * 1024);
+    testStream->start_stream();
+    CAdtsDemuxer readDemuxer(*testStream, false);
+    readTime = std::min(readTime, demux(readDemuxer));
+
+    SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+    testStream->SetSegmentBufferPool(&pool);
+    testStream->SetSegmentData(segmentData, 64 * 1024);
+    testStream->start_stream();
+    CAdtsDemuxer viewDemuxer(*testStream, true);
+    viewTime = std::min(viewTime, demux(viewDemuxer));
+    viewReads = testStream->GetViewReads();
+
+    ASSERT_EQ(readDemuxer.m_bytes, DEMUX_BYTES);
+    ASSERT_EQ(viewDemuxer.m_bytes, DEMUX_BYTES);
+    EXPECT_EQ(viewDemuxer.m_checksum, readDemuxer.m_checksum);
+  }
+  SetTestStream(nullptr);
+
+  // Only the frames of a segment still in download are read to the frame buffer
+  EXPECT_GT(viewReads, 0);
+
+  const auto toMiBPerSecond = [](Clock::duration duration) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    return static_cast<int>(DEMUX_BYTES * 1000000 / (1024 * 1024) / std::max<decltype(us)>(us, 1));
+  };
+  RecordProperty("ReadMiBPerSec", toMiBPerSecond(readTime));
+  RecordProperty("ViewMiBPerSec", toMiBPerSecond(viewTime));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, DownloadAllocationsPerMiB)
+{
+  // Download the segments with the CURL download implementation, writing the data in place
+  // to the segment buffer, compared with the data processed by the tree with an intermediate
+  // buffer. The heap allocations per MiB are reported as test properties,
+  // e.g. with --gtest_output=xml
+  constexpr size_t SEGMENT_SIZE = 1024 * 1024;
+  constexpr size_t SEGMENTS = 8;
+  OpenTestFile("mpd/segtpl.mpd", "https://foo.bar/mpd/test.mpd");
+
+  kodi::vfs::CFile::testData.resize(SEGMENT_SIZE);
+  for (size_t pos = 0; pos < SEGMENT_SIZE; ++pos)
+    kodi::vfs::CFile::testData[pos] = static_cast<uint8_t>(pos * 7 + (pos >> 8));
+
+  const auto download = [&](bool isDataProcessingRequired, double& allocationsPerMiB) {
+    tree->SetDataProcessingRequired(isDataProcessingRequired);
+    SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+    testStream->SetCurlDownload(true);
+    testStream->start_stream();
+
+    // The initialization segment is followed by the media segments
+    std::vector<uint8_t> data(64 * 1024);
+    for (size_t pos = 0; pos < (SEGMENTS + 1) * SEGMENT_SIZE; pos += data.size())
+    {
+      ASSERT_TRUE(testStream->read(data.data(), data.size()));
+      ASSERT_EQ(data[0], kodi::vfs::CFile::testData[pos % SEGMENT_SIZE]);
+    }
+
+    // Stop the download worker, so the counters are not updated meantime
+    testStream->Stop();
+    ASSERT_GE(testStream->GetCurlBytes(), (SEGMENTS + 1) * SEGMENT_SIZE);
+    allocationsPerMiB = static_cast<double>(testStream->GetCurlAllocations()) * 1024 * 1024 /
+                        testStream->GetCurlBytes();
+  };
+
+  double inPlaceAllocations{0};
+  double processedAllocations{0};
+  download(false, inPlaceAllocations);
+  download(true, processedAllocations);
+  kodi::vfs::CFile::testData.clear();
+  tree->SetDataProcessingRequired(false);
+
+  // The segment buffer is reserved from the content length, so the data written in place
+  // dont reallocate it, while the processed data grow it chunk by chunk
+  EXPECT_LT(inPlaceAllocations, processedAllocations);
+
+  RecordProperty("InPlaceAllocationsPerMiB", std::to_string(inPlaceAllocations));
+  RecordProperty("ProcessedAllocationsPerMiB", std::to_string(processedAllocations));
+}
+
+TEST_F(DASHTreeAdaptiveStreamTest, PauseWhileWaitingToRetry)
+{
+  OpenTestFile("mpd/segtpl.mpd", "https://foo.bar/mpd/test.mpd");
+  SetTestStream(NewStream(tree->m_periods[0]->GetAdaptationSets()[0].get()));
+
+  // With 2 secs segments the third retry is delayed at least 500 ms
+  testStream->SetFailedDownloads(3);
+  testStream->start_stream();
+  EXPECT_EQ(testStream->read(buf, 16), 16);
+
+  // Read the next segment, that waits for the download retries
+  uint32_t bytesRead = 0;
+  std::thread reader([this, &bytesRead] { bytesRead = testStream->read(buf, 16); });
+
+  const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (testStream->GetDownloadRetryCount() < 3 && std::chrono::steady_clock::now() < timeout)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_EQ(testStream->GetDownloadRetryCount(), 3);
+
+  // Pause the worker, as on seek, without waiting for the retry delay
+  size_t size;
+  const auto pauseTime = std::chrono::steady_clock::now();
+  EXPECT_TRUE(testStream->retrieveCurrentSegmentBufferSize(size));
+  EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - pauseTime)
+                .count(),
+            250);
+
+  // The download is retried when the worker runs again, without losing an attempt
+  reader.join();
+  EXPECT_EQ(bytesRead, 16);
+  EXPECT_EQ(testStream->GetDownloadRetryCount(), 3);
+  EXPECT_EQ(testStream->GetDownloadAbortCount(), 0);
+}
+
 TEST_F(DASHTreeTest, AdaptionSetSwitching)
 {
   OpenTestFile("mpd/adaptation_set_switching.mpd");
@@ -0,0 +1,165 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/DownloadScheduler.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace adaptive;
+
+namespace
+{
+using Priority = CDownloadScheduler::Priority;
+
+const auto NEVER_CANCEL = [] { return false; };
+
+// Records the order in which the requests acquire their download slot
+class CRequestRecorder
+{
+public:
+  explicit CRequestRecorder(CDownloadScheduler& scheduler) : m_scheduler{scheduler} {}
+
+  ~CRequestRecorder()
+  {
+    for (std::thread& thread : m_threads)
+      thread.join();
+  }
+
+  // Start a request from a new thread, each request release the slot once acquired
+  void Start(uint32_t clientId, Priority priority, int id)
+  {
+    const size_t queueDepth = m_scheduler.GetQueueDepth(clientId);
+    m_threads.emplace_back(
+        [this, clientId, priority, id]
+        {
+          if (m_scheduler.Acquire(clientId, priority, this, NEVER_CANCEL))
+          {
+            {
+              std::lock_guard<std::mutex> lock(m_mutex);
+              m_order.emplace_back(id);
+            }
+            m_scheduler.Release(clientId);
+          }
+        });
+    // Wait until the request is queued, to have a deterministic order
+    while (m_scheduler.GetQueueDepth(clientId) == queueDepth)
+      std::this_thread::yield();
+  }
+
+  std::vector<int> Join()
+  {
+    for (std::thread& thread : m_threads)
+      thread.join();
+    m_threads.clear();
+    return m_order;
+  }
+
+private:
+  CDownloadScheduler& m_scheduler;
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::vector<int> m_order;
+};
+} // unnamed namespace
+
+class DownloadSchedulerTest : public ::testing::Test
+{
+};
+
+TEST_F(DownloadSchedulerTest, ServedByPriority)
+{
+  CDownloadScheduler scheduler(1);
+  ASSERT_TRUE(scheduler.Acquire(0, Priority::NORMAL, nullptr, NEVER_CANCEL));
+
+  CRequestRecorder recorder(scheduler);
+  recorder.Start(1, Priority::LOW, 1);
+  recorder.Start(2, Priority::NORMAL, 2);
+  recorder.Start(3, Priority::HIGH, 3);
+  recorder.Start(4, Priority::HIGH, 4);
+
+  scheduler.Release(0);
+  EXPECT_EQ(recorder.Join(), std::vector<int>({3, 4, 2, 1}));
+}
+
+TEST_F(DownloadSchedulerTest, UrgentServedFirst)
+{
+  CDownloadScheduler scheduler(1);
+  ASSERT_TRUE(scheduler.Acquire(0, Priority::NORMAL, nullptr, NEVER_CANCEL));
+
+  CRequestRecorder recorder(scheduler);
+  recorder.Start(1, Priority::HIGH, 1);
+  recorder.Start(2, Priority::LOW, 2);
+  // The demux reader is now waiting for the data of the low priority request
+  scheduler.Promote(2, &recorder);
+
+  scheduler.Release(0);
+  EXPECT_EQ(recorder.Join(), std::vector<int>({2, 1}));
+}
+
+TEST_F(DownloadSchedulerTest, LowPriorityAging)
+{
+  CDownloadScheduler scheduler(1);
+  ASSERT_TRUE(scheduler.Acquire(0, Priority::NORMAL, nullptr, NEVER_CANCEL));
+
+  CRequestRecorder recorder(scheduler);
+  recorder.Start(1, Priority::LOW, 100);
+  // Under a steady load of high priority requests the low priority one
+  // must be served after it has been bypassed by the aging grants
+  const int highRequests = static_cast<int>(CDownloadScheduler::AGING_GRANTS) * 3;
+  for (int i = 0; i < highRequests; i++)
+    recorder.Start(2, Priority::HIGH, i);
+
+  scheduler.Release(0);
+  const std::vector<int> order = recorder.Join();
+
+  ASSERT_EQ(order.size(), static_cast<size_t>(highRequests + 1));
+  // LOW -> NORMAL -> HIGH takes two aging steps, then it is the oldest HIGH request
+  const auto it = std::find(order.cbegin(), order.cend(), 100);
+  EXPECT_EQ(static_cast<size_t>(std::distance(order.cbegin(), it)),
+            static_cast<size_t>(CDownloadScheduler::AGING_GRANTS * 2));
+}
+
+TEST_F(DownloadSchedulerTest, MaxDownloads)
+{
+  CDownloadScheduler scheduler(2);
+  EXPECT_TRUE(scheduler.Acquire(1, Priority::HIGH, nullptr, NEVER_CANCEL));
+  EXPECT_TRUE(scheduler.Acquire(2, Priority::LOW, nullptr, NEVER_CANCEL));
+
+  std::atomic<bool> isCancelled{false};
+  std::atomic<bool> isAcquired{false};
+  std::thread thread(
+      [&]
+      {
+        isAcquired = scheduler.Acquire(1, Priority::URGENT, nullptr,
+                                       [&isCancelled] { return isCancelled.load(); });
+      });
+
+  while (scheduler.GetQueueDepth(1) != 2)
+    std::this_thread::yield();
+
+  // No slot is free, the request wait until cancelled
+  isCancelled = true;
+  scheduler.Interrupt();
+  thread.join();
+
+  EXPECT_FALSE(isAcquired);
+  EXPECT_EQ(scheduler.GetQueueDepth(1), 1);
+  EXPECT_EQ(scheduler.GetQueueDepth(2), 1);
+
+  scheduler.Release(1);
+  scheduler.Release(2);
+  EXPECT_EQ(scheduler.GetQueueDepth(1), 0);
+  EXPECT_EQ(scheduler.GetQueueDepth(2), 0);
+}
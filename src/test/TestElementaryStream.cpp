@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../lib/mpegts/mpegts/ES_h264.h"
+#include "../../lib/mpegts/mpegts/ES_hevc.h"
+
+#include <gtest/gtest.h>
+
+#include <initializer_list>
+#include <vector>
+
+using namespace TSDemux;
+
+namespace
+{
+// Sizes of the access units, bigger than the initial buffer size of the video streams
+const std::vector<size_t> UNIT_SIZES = {300000, 180000, 420000, 250000};
+constexpr size_t UNITS = 200;
+
+void AppendNalUnit(std::vector<uint8_t>& unit, std::initializer_list<uint8_t> header, size_t size)
+{
+  unit.insert(unit.end(), {0, 0, 0, 1});
+  unit.insert(unit.end(), header);
+  // The payload never contains a start code
+  for (size_t i = unit.size(); size > 0; ++i, --size)
+    unit.emplace_back(static_cast<uint8_t>(0x80 | (i & 0x7f)));
+}
+
+// Feed a PES unit for each access unit, made of a SEI and a slice NAL units. Without the
+// parameter sets no packets are returned, but the parser consumes each complete access unit
+uint64_t FeedAccessUnits(ElementaryStream& es,
+                         std::initializer_list<uint8_t> seiHeader,
+                         std::initializer_list<uint8_t> sliceHeader)
+{
+  uint64_t appendedBytes{0};
+  STREAM_PKT pkt;
+
+  for (size_t count = 0; count < UNITS; ++count)
+  {
+    std::vector<uint8_t> unit;
+    AppendNalUnit(unit, seiHeader, 16);
+    AppendNalUnit(unit, sliceHeader, UNIT_SIZES[count % UNIT_SIZES.size()]);
+
+    EXPECT_EQ(es.Append(unit.data(), unit.size(), true), 0);
+    appendedBytes += unit.size();
+
+    while (es.GetStreamPacket(&pkt))
+    {
+    }
+  }
+  return appendedBytes;
+}
+} // unnamed namespace
+
+class ElementaryStreamTest : public ::testing::Test
+{
+};
+
+TEST_F(ElementaryStreamTest, H264LargeUnitsBufferStats)
+{
+  ES_h264 es(0x100);
+  const uint64_t appendedBytes = FeedAccessUnits(es, {0x06}, {0x65});
+
+  // The buffer grows up to fit the pending units, then it is reused
+  EXPECT_LE(es.GetAllocCount(), 3);
+  // The pending payload is moved only when there is no room left at the buffer end,
+  // not on each append, and a move copies only the unit not yet parsed
+  EXPECT_GT(es.GetMoveCount(), 0);
+  EXPECT_LT(es.GetMoveCount(), UNITS);
+  EXPECT_LE(es.GetMoveBytes(), appendedBytes / 2);
+
+  RecordProperty("Allocations", static_cast<int>(es.GetAllocCount()));
+  RecordProperty("Moves", static_cast<int>(es.GetMoveCount()));
+  RecordProperty("MovedKiB", static_cast<int>(es.GetMoveBytes() / 1024));
+}
+
+TEST_F(ElementaryStreamTest, HevcLargeUnitsBufferStats)
+{
+  ES_hevc es(0x100);
+  // Prefix SEI and TRAIL_R slice NAL unit headers
+  const uint64_t appendedBytes = FeedAccessUnits(es, {0x4E, 0x01}, {0x02, 0x01});
+
+  EXPECT_LE(es.GetAllocCount(), 3);
+  EXPECT_GT(es.GetMoveCount(), 0);
+  EXPECT_LT(es.GetMoveCount(), UNITS);
+  EXPECT_LE(es.GetMoveBytes(), appendedBytes / 2);
+
+  RecordProperty("Allocations", static_cast<int>(es.GetAllocCount()));
+  RecordProperty("Moves", static_cast<int>(es.GetMoveCount()));
+  RecordProperty("MovedKiB", static_cast<int>(es.GetMoveBytes() / 1024));
+}
@@ -196,6 +196,27 @@ TEST_F(HLSTreeTest, OpenVariant)
   EXPECT_EQ(tree->base_url_, "https://foo.bar/");
 }
 
+TEST_F(HLSTreeTest, KeepAbsoluteSegmentUrls)
+{
+  OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/hls/video/stream_name/master.m3u8");
+
+  PLAYLIST::PrepareRepStatus res = OpenTestFileVariant(
+      "hls/ts_absolute_segments_stream_0.m3u8",
+      "https://foo.bar/hls/video/stream_name/chunklist.m3u8", tree->m_currentPeriod,
+      tree->m_currentAdpSet, tree->m_currentRepr);
+  EXPECT_EQ(res, PLAYLIST::PrepareRepStatus::OK);
+
+  // A playlist refresh redirected elsewhere change the base url,
+  // the segments already parsed must keep their url
+  tree->m_currentRepr->SetBaseUrl("https://baz.qux/other/");
+
+  const auto& timeline = tree->m_currentRepr->SegmentTimeline();
+  ASSERT_EQ(timeline.GetSize(), 3);
+  EXPECT_EQ(timeline.Get(0)->url, "https://foo.bar/hls/video/stream_name/media-abc_10.ts");
+  EXPECT_EQ(timeline.Get(1)->url, "https://foo.bar/hls/video/stream_name/media-abc_11.ts");
+  EXPECT_EQ(timeline.Get(2)->url, "https://cdn.foo.bar/hls/video/stream_name/media-abc_12.ts");
+}
+
 TEST_F(HLSTreeTest, ParseKeyUriStartingWithSlash)
 {
   OpenTestFileMaster("hls/1v_master.m3u8", "https://foo.bar/hls/video/stream_name/master.m3u8");
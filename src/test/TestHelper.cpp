@@ -10,9 +10,39 @@
 
 #include "../utils/CurlUtils.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <string_view>
+#include <thread>
+
 std::string testHelper::testFile;
 std::string testHelper::effectiveUrl;
 std::vector<std::string> testHelper::downloadList;
+thread_local bool testHelper::isCountAllocations{false};
+thread_local size_t testHelper::allocationsCount{0};
+
+// Instrumented global allocator, allow tests to check that a code path dont allocate memory
+void* operator new(std::size_t size)
+{
+  if (testHelper::isCountAllocations)
+    testHelper::allocationsCount++;
+
+  if (void* ptr = std::malloc(size == 0 ? 1 : size))
+    return ptr;
+
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
 
 bool testHelper::LoadFile(std::string path, std::string& data)
 {
@@ -89,37 +119,64 @@ bool TestAdaptiveStream::DownloadSegment(const DownloadInfo& downloadInfo)
   if (downloadInfo.m_url.empty())
     return false;
 
+  if (m_failedDownloads > 0 && !downloadInfo.m_segmentBuffer->segment.IsInitialization())
+  {
+    m_failedDownloads--;
+    return false;
+  }
+
+  if (m_inPlaceSegmentSize > 0)
+    return DownloadSegmentInPlace(downloadInfo);
+
+  if (m_isCurlDownload)
+  {
+    // Count the allocations of the calling thread, the download worker or the reader
+    // thread for the initialization segment
+    const size_t allocations = testHelper::allocationsCount;
+    testHelper::isCountAllocations = true;
+    const bool ret = AdaptiveStream::DownloadSegment(downloadInfo);
+    testHelper::isCountAllocations = false;
+    m_curlAllocations += testHelper::allocationsCount - allocations;
+    m_curlBytes += downloadInfo.m_segmentBuffer->data_size;
+
+    if (ret)
+      testHelper::downloadList.push_back(downloadInfo.m_url);
+    return ret;
+  }
+
   std::vector<uint8_t>& segmentBuffer = downloadInfo.m_segmentBuffer->buffer;
-  std::stringstream sampleData("Sixteen bytes!!!");
+  static const std::string_view defaultData{"Sixteen bytes!!!"};
 
-  const size_t bufferSize = 8;
-  uint8_t bufferData[bufferSize];
+  const uint8_t* sampleData = reinterpret_cast<const uint8_t*>(defaultData.data());
+  size_t sampleDataSize = defaultData.size();
+  size_t bufferSize = 8;
+  if (!m_segmentData.empty())
+  {
+    sampleData = m_segmentData.data();
+    sampleDataSize = m_segmentData.size();
+    bufferSize = m_segmentDataChunkSize;
+  }
   size_t totalByteRead = 0;
 
-  sampleData.clear();
-  sampleData.seekg(0);
-
   // Simulate the downloading/reading data in chunks
-  while (true)
+  while (totalByteRead < sampleDataSize)
   {
-    {
-      std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
-
-      if (state_ == STOPPED)
-        break;
+    std::lock_guard<std::mutex> lckrw(thread_data_->mutex_rw_);
 
-      sampleData.read(reinterpret_cast<char*>(bufferData), bufferSize);
-      size_t bytesRead = sampleData.gcount();
+    if (state_ == STOPPED)
+      break;
 
-      if (bytesRead == 0) // EOF
-        break;
+    const size_t bytesRead = std::min(bufferSize, sampleDataSize - totalByteRead);
 
-      tree_.OnDataArrived(downloadInfo.m_segmentBuffer->segment_number,
-                          downloadInfo.m_segmentBuffer->segment.pssh_set_, m_decrypterIv,
-                          bufferData, bytesRead, segmentBuffer, segmentBuffer.size(), false);
+    CReallocGuard reallocGuard{*this};
+    tree_.OnDataArrived(downloadInfo.m_segmentBuffer->segment_number,
+                        downloadInfo.m_segmentBuffer->segment.pssh_set_,
+                        downloadInfo.m_segmentBuffer->decrypter_iv,
+                        sampleData + totalByteRead, bytesRead, segmentBuffer, segmentBuffer.size(),
+                        false);
+    downloadInfo.m_segmentBuffer->data_size = segmentBuffer.size();
 
-      totalByteRead += bytesRead;
-    }
+    totalByteRead += bytesRead;
   }
 
   if (totalByteRead == 0)
@@ -134,6 +191,63 @@ bool TestAdaptiveStream::DownloadSegment(const DownloadInfo& downloadInfo)
   return true;
 }
 
+bool TestAdaptiveStream::DownloadSegmentInPlace(const DownloadInfo& downloadInfo)
+{
+  SEGMENTBUFFER& segBuffer = *downloadInfo.m_segmentBuffer;
+  const uint64_t segmentNumber = segBuffer.segment_number;
+  size_t dataSize = 0;
+
+  while (dataSize < m_inPlaceSegmentSize)
+  {
+    const size_t chunkSize = std::min(m_inPlaceChunkSize, m_inPlaceSegmentSize - dataSize);
+    {
+      std::unique_lock<std::mutex> lckrw(thread_data_->mutex_rw_);
+
+      // Wait for the reader to be in the middle of the last chunk, so the memory
+      // is reallocated while it is reading the same buffer. The initialization
+      // segment is downloaded by the reader thread, so cannot wait for it
+      while (dataSize > 0 && !segBuffer.segment.IsInitialization() && state_ != STOPPED &&
+             (segment_buffers_[0] != &segBuffer ||
+              segment_read_pos_ < dataSize - m_inPlaceChunkSize / 2))
+      {
+        lckrw.unlock();
+        std::this_thread::yield();
+        lckrw.lock();
+      }
+
+      if (state_ == STOPPED)
+        return false;
+
+      // Move the data to a new memory for each chunk, and overwrite the old memory,
+      // so a read not protected by the guard would get wrong data
+      CReallocGuard reallocGuard{*this};
+      std::vector<uint8_t> newBuffer;
+      newBuffer.reserve(dataSize + chunkSize);
+      newBuffer.assign(segBuffer.buffer.begin(), segBuffer.buffer.begin() + dataSize);
+      std::fill(segBuffer.buffer.begin(), segBuffer.buffer.end(), 0xAA);
+      // Leave time to the reader to read the old memory, if it can
+      std::this_thread::sleep_for(std::chrono::microseconds(10));
+      segBuffer.buffer.swap(newBuffer);
+      segBuffer.buffer.resize(dataSize + chunkSize);
+    }
+
+    // Write the chunk without lock, as ReadChunkInPlace do
+    for (size_t pos = dataSize; pos < dataSize + chunkSize; ++pos)
+    {
+      if (pos < sizeof(segmentNumber))
+        segBuffer.buffer[pos] = reinterpret_cast<const uint8_t*>(&segmentNumber)[pos];
+      else
+        segBuffer.buffer[pos] = GetInPlaceByte(segmentNumber, pos);
+    }
+    dataSize += chunkSize;
+
+    CommitSegmentData(segBuffer, dataSize);
+  }
+
+  testHelper::downloadList.push_back(downloadInfo.m_url);
+  return true;
+}
+
 bool TestAdaptiveStream::Download(const DownloadInfo& downloadInfo, std::vector<uint8_t>& data)
 {
   const char* dataStr = "Sixteen bytes!!!";
@@ -18,6 +18,7 @@
 #include "../utils/log.h"
 #include "../utils/PropertiesUtils.h"
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
 #include <string_view>
@@ -42,6 +43,10 @@ public:
   static std::string testFile;
   static std::string effectiveUrl;
   static std::vector<std::string> downloadList;
+
+  // \brief Number of heap allocations done by the current thread while isCountAllocations is true
+  static thread_local bool isCountAllocations;
+  static thread_local size_t allocationsCount;
 };
 
 class CTestRepresentationChooserDefault : public CHOOSER::CRepresentationChooserDefault
@@ -65,6 +70,8 @@ public:
     : adaptive::AdaptiveStream(tree, adp, initialRepr, kodiProps)
   {
   }
+  // The download worker uses the test data, it must be stopped before they are destroyed
+  ~TestAdaptiveStream() override { Stop(); }
 
   std::chrono::system_clock::time_point mock_time_stream = std::chrono::system_clock::now();
   void SetLastUpdated(const std::chrono::system_clock::time_point tm) override
@@ -73,8 +80,69 @@ public:
   }
   virtual bool DownloadSegment(const DownloadInfo& downloadInfo) override;
 
+  /*!
+   * \brief Download the segments by writing the data in place, chunk by chunk as done by the
+   *        download worker, but forcing a reallocation of the buffer memory for each chunk.
+   *        Each segment starts with its segment number (uint64_t), followed by the bytes
+   *        returned by GetInPlaceByte.
+   * \param segmentSize The size of each segment
+   * \param chunkSize The size of each chunk
+   */
+  void SetInPlaceDownload(size_t segmentSize, size_t chunkSize)
+  {
+    m_inPlaceSegmentSize = segmentSize;
+    m_inPlaceChunkSize = chunkSize;
+  }
+
+  static uint8_t GetInPlaceByte(uint64_t segmentNumber, size_t pos)
+  {
+    return static_cast<uint8_t>(segmentNumber * 31 + pos * 7 + (pos >> 8));
+  }
+
+  /*!
+   * \brief Download the segments with the specified data, instead of the sixteen bytes
+   * \param data The data of each segment
+   * \param chunkSize The size of the chunks written to the segment buffer
+   */
+  void SetSegmentData(std::vector<uint8_t> data, size_t chunkSize)
+  {
+    m_segmentData = std::move(data);
+    m_segmentDataChunkSize = chunkSize;
+  }
+
+  /*!
+   * \brief Download the segments with the AdaptiveStream implementation, the response data
+   *        are read from the CFile stub (kodi::vfs::CFile::testData)
+   */
+  void SetCurlDownload(bool isEnabled) { m_isCurlDownload = isEnabled; }
+
+  // \brief Heap allocations done and bytes downloaded by the CURL segment downloads
+  size_t GetCurlAllocations() const { return m_curlAllocations; }
+  uint64_t GetCurlBytes() const { return m_curlBytes; }
+
+  uint64_t GetLockFreeReads() const { return m_lockFreeReads; }
+  uint64_t GetViewReads() const { return m_viewReads; }
+
+  /*!
+   * \brief Make the next media segment downloads fail, as during a network outage
+   * \param count The number of downloads to fail
+   */
+  void SetFailedDownloads(size_t count) { m_failedDownloads = count; }
+
 protected:
   virtual bool Download(const DownloadInfo& downloadInfo, std::vector<uint8_t>& data) override;
+
+private:
+  bool DownloadSegmentInPlace(const DownloadInfo& downloadInfo);
+
+  size_t m_inPlaceSegmentSize{0};
+  size_t m_inPlaceChunkSize{0};
+  std::vector<uint8_t> m_segmentData;
+  size_t m_segmentDataChunkSize{0};
+  std::atomic<size_t> m_failedDownloads{0};
+  bool m_isCurlDownload{false};
+  std::atomic<size_t> m_curlAllocations{0};
+  std::atomic<uint64_t> m_curlBytes{0};
 };
 
 class AESDecrypter : public IAESDecrypter
@@ -108,6 +176,13 @@ public:
   void SetLastUpdated(const std::chrono::system_clock::time_point tm) { lastUpdated_ = tm; }
   std::chrono::system_clock::time_point GetNowTimeChrono() { return m_mock_time_chrono; };
 
+  // \brief Make the downloaded data be processed by OnDataArrived, as for encrypted segments
+  void SetDataProcessingRequired(bool isRequired) { m_isDataProcessingRequired = isRequired; }
+  bool IsDataProcessingRequired(uint16_t psshSet) const override
+  {
+    return m_isDataProcessingRequired;
+  }
+
   /*!
    * \brief Run manually a manifest update with the specified file
    * \return The url used to make the manifest request
@@ -126,6 +201,7 @@ private:
   std::chrono::system_clock::time_point m_mock_time_chrono = std::chrono::system_clock::now();
 
   std::string m_manifestUpdUrl; // Temporarily stores the url where to request the manifest update
+  bool m_isDataProcessingRequired{false};
 };
 
 class HLSTestTree : public adaptive::CHLSTree
@@ -0,0 +1,257 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../samplereader/SampleReader.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// Reader of numbered samples, the PTS diff changes with each sample as on a segment change
+class CFakeSampleReader : public ISampleReader
+{
+public:
+  CFakeSampleReader(size_t samples) : m_samples(samples) {}
+  ~CFakeSampleReader() override
+  {
+    SetBlocked(false);
+    WaitReadSampleAsyncComplete();
+  }
+
+  bool EOS() const override { return m_index >= m_samples; }
+  uint64_t DTS() const override { return m_index * 1000; }
+  uint64_t PTS() const override { return m_index * 1000; }
+  AP4_Result Start(bool& bStarted) override
+  {
+    bStarted = true;
+    return AP4_SUCCESS;
+  }
+  AP4_Result ReadSample() override
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_isReadStarted = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [this] { return !m_isBlocked; });
+
+    m_reads++;
+    if (++m_index >= m_samples)
+      return AP4_ERROR_EOS;
+    m_data.assign(4, static_cast<AP4_Byte>(m_index));
+    return AP4_SUCCESS;
+  }
+  void Reset(bool bEOS) override {}
+  bool GetInformation(kodi::addon::InputstreamInfo& info) override { return false; }
+  bool TimeSeek(uint64_t pts, bool preceeding) override { return true; }
+  void SetPTSOffset(uint64_t offset) override {}
+  int64_t GetPTSDiff() const override { return static_cast<int64_t>(m_index) * 10; }
+  void SetStartPTS(uint64_t pts) override {}
+  uint64_t GetStartPTS() const override { return 0; }
+  uint32_t GetTimeScale() const override { return 1000; }
+  AP4_UI32 GetStreamId() const override { return 1; }
+  AP4_Size GetSampleDataSize() const override
+  {
+    return static_cast<AP4_Size>(EOS() ? 0 : m_data.size());
+  }
+  const AP4_Byte* GetSampleData() const override { return m_data.data(); }
+  uint64_t GetDuration() const override { return 1000; }
+  bool IsEncrypted() const override { return false; }
+  bool IsStarted() const override { return true; }
+
+  void SetBlocked(bool isBlocked)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isBlocked = isBlocked;
+    m_cv.notify_all();
+  }
+
+  // Wait for the worker thread to be blocked in ReadSample
+  bool WaitReadStarted()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    const bool ret =
+        m_cv.wait_for(lock, std::chrono::seconds(5), [this] { return m_isReadStarted; });
+    m_isReadStarted = false;
+    return ret;
+  }
+
+  size_t GetReads()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reads;
+  }
+
+  // To be called after WaitReadSampleAsyncComplete, so the reader can be repositioned
+  void SetIndex(size_t index)
+  {
+    m_index = index;
+    m_data.assign(4, static_cast<AP4_Byte>(m_index));
+  }
+
+private:
+  size_t m_samples;
+  size_t m_index{0};
+  std::vector<AP4_Byte> m_data{std::vector<AP4_Byte>(4, 0)};
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_isBlocked{false};
+  bool m_isReadStarted{false};
+  size_t m_reads{0};
+};
+
+// Wait for the sample to be demuxed, as the demux thread do with IsReadSampleAsyncWorking
+bool WaitDemuxSample(ISampleReader& reader)
+{
+  const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (reader.IsReadSampleAsyncWorking())
+  {
+    if (std::chrono::steady_clock::now() > timeout)
+      return false;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+// Wait for the worker thread to fill the ring
+void WaitReads(CFakeSampleReader& reader, size_t reads)
+{
+  const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (reader.GetReads() < reads && std::chrono::steady_clock::now() < timeout)
+    std::this_thread::yield();
+}
+} // unnamed namespace
+
+class SampleReaderTest : public ::testing::Test
+{
+};
+
+TEST_F(SampleReaderTest, RingKeepOrder)
+{
+  CFakeSampleReader reader(20);
+  reader.SetReadAhead(4, nullptr);
+
+  // The first sample is read by the demux thread, the next ones by the worker
+  ASSERT_EQ(reader.ReadSample(), AP4_SUCCESS);
+  reader.ReadSampleAsync();
+
+  for (uint64_t index = 2; index < 20; ++index)
+  {
+    ASSERT_TRUE(WaitDemuxSample(reader));
+    const ISampleReader::DemuxSample sample = reader.GetDemuxSample();
+    ASSERT_FALSE(sample.m_isEOS);
+    EXPECT_EQ(sample.m_pts, index * 1000);
+    EXPECT_EQ(sample.m_dataSize, 4);
+    EXPECT_EQ(sample.m_data[0], index);
+    // The samples can be already read ahead, the PTS diff is the one of the demuxed sample
+    EXPECT_EQ(sample.m_ptsDiff, static_cast<int64_t>(index * 10));
+    EXPECT_EQ(reader.GetDemuxPTSDiff(), static_cast<int64_t>(index * 10));
+    reader.ReadSampleAsync();
+  }
+  ASSERT_TRUE(WaitDemuxSample(reader));
+  EXPECT_TRUE(reader.GetDemuxSample().m_isEOS);
+  EXPECT_EQ(reader.GetReadSampleCount(), 19);
+}
+
+TEST_F(SampleReaderTest, AsyncWorkingUntilSampleRead)
+{
+  CFakeSampleReader reader(20);
+  reader.SetReadAhead(4, nullptr);
+  ASSERT_EQ(reader.ReadSample(), AP4_SUCCESS);
+  const int64_t ptsDiff = reader.GetDemuxPTSDiff();
+
+  reader.SetBlocked(true);
+  reader.ReadSampleAsync();
+  ASSERT_TRUE(reader.WaitReadStarted());
+
+  // The sample to be demuxed is being read, the reader state cannot be used
+  EXPECT_TRUE(reader.IsReadSampleAsyncWorking());
+  EXPECT_EQ(reader.GetDemuxPTSDiff(), ptsDiff);
+
+  reader.SetBlocked(false);
+  ASSERT_TRUE(WaitDemuxSample(reader));
+  EXPECT_EQ(reader.GetDemuxSample().m_pts, 2000);
+
+  // Reading ahead the next samples dont make the demuxed sample not ready
+  WaitReads(reader, 5);
+  reader.SetBlocked(true);
+  EXPECT_FALSE(reader.IsReadSampleAsyncWorking());
+  EXPECT_EQ(reader.GetDemuxSample().m_pts, 2000);
+  EXPECT_EQ(reader.GetDemuxPTSDiff(), 20);
+
+  reader.SetBlocked(false);
+  reader.WaitReadSampleAsyncComplete();
+  EXPECT_FALSE(reader.IsReadSampleAsyncWorking());
+}
+
+TEST_F(SampleReaderTest, PauseStopReadAhead)
+{
+  CFakeSampleReader reader(20);
+  reader.SetReadAhead(4, nullptr);
+  ASSERT_EQ(reader.ReadSample(), AP4_SUCCESS);
+  reader.ReadSampleAsync();
+  ASSERT_TRUE(WaitDemuxSample(reader));
+
+  // The worker is idle after the wait, until the next ReadSampleAsync
+  reader.WaitReadSampleAsyncComplete();
+  const size_t reads = reader.GetReads();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(reader.GetReads(), reads);
+  EXPECT_EQ(reader.GetPTSDiff(), static_cast<int64_t>(reads) * 10);
+
+  reader.ReadSampleAsync();
+  WaitReads(reader, reads + 1);
+  EXPECT_GT(reader.GetReads(), reads);
+}
+
+TEST_F(SampleReaderTest, ClearReadAhead)
+{
+  CFakeSampleReader reader(20);
+  reader.SetReadAhead(4, nullptr);
+  ASSERT_EQ(reader.ReadSample(), AP4_SUCCESS);
+  reader.ReadSampleAsync();
+  ASSERT_TRUE(WaitDemuxSample(reader));
+  WaitReads(reader, 5);
+
+  // Reposition the reader, as done by a seek
+  reader.WaitReadSampleAsyncComplete();
+  reader.ClearReadAhead();
+  reader.SetIndex(10);
+
+  EXPECT_FALSE(reader.IsReadSampleAsyncWorking());
+  const ISampleReader::DemuxSample sample = reader.GetDemuxSample();
+  EXPECT_EQ(sample.m_pts, 10000);
+  EXPECT_EQ(sample.m_data[0], 10);
+  EXPECT_EQ(reader.GetDemuxPTSDiff(), 100);
+
+  reader.ReadSampleAsync();
+  ASSERT_TRUE(WaitDemuxSample(reader));
+  EXPECT_EQ(reader.GetDemuxSample().m_pts, 11000);
+}
+
+TEST_F(SampleReaderTest, NoReadAheadWithDepthOne)
+{
+  CFakeSampleReader reader(20);
+  reader.SetReadAhead(1, nullptr);
+  ASSERT_EQ(reader.ReadSample(), AP4_SUCCESS);
+
+  for (uint64_t index = 2; index < 6; ++index)
+  {
+    reader.ReadSampleAsync();
+    ASSERT_TRUE(WaitDemuxSample(reader));
+    EXPECT_EQ(reader.GetDemuxSample().m_pts, index * 1000);
+    // Only the requested sample is read
+    EXPECT_EQ(reader.GetReads(), index);
+    EXPECT_EQ(reader.GetDemuxPTSDiff(), static_cast<int64_t>(index * 10));
+  }
+}
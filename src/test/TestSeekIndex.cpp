@@ -0,0 +1,328 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../../lib/mpegts/mpegts/seekIndex.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace TSDemux;
+
+namespace
+{
+constexpr uint16_t VIDEO_PID = 0x100;
+constexpr uint16_t OTHER_PID = 0x101;
+
+void EncodePts(uint64_t pts, uint8_t* p)
+{
+  p[0] = static_cast<uint8_t>(0x21 | ((pts >> 29) & 0x0E));
+  p[1] = static_cast<uint8_t>(pts >> 22);
+  p[2] = static_cast<uint8_t>(((pts >> 14) & 0xFE) | 1);
+  p[3] = static_cast<uint8_t>(pts >> 7);
+  p[4] = static_cast<uint8_t>(((pts << 1) & 0xFE) | 1);
+}
+
+// Append the TS packets of a PES with a PTS, the bytes after the first 188 of each packet
+// are filled with the extra data
+void AppendPes(std::vector<uint8_t>& data,
+               size_t packetSize,
+               uint16_t pid,
+               uint64_t pts,
+               const std::vector<uint8_t>& es,
+               bool isRandomAccess = false,
+               const std::vector<uint8_t>& extra = {})
+{
+  size_t esPos = 0;
+  bool isFirst = true;
+  while (isFirst || esPos < es.size())
+  {
+    std::vector<uint8_t> packet(packetSize, 0xFF);
+    packet[0] = 0x47;
+    packet[1] = static_cast<uint8_t>((isFirst ? 0x40 : 0) | pid >> 8);
+    packet[2] = static_cast<uint8_t>(pid);
+    packet[3] = 0x10;
+    size_t pos = 4;
+    if (isFirst && isRandomAccess)
+    {
+      packet[3] |= 0x20;
+      packet[pos++] = 1;
+      packet[pos++] = 0x40;
+    }
+    if (isFirst)
+    {
+      const uint8_t pesHeader[] = {0, 0, 1, 0xE0, 0, 0, 0x80, 0x80, 5};
+      std::copy(pesHeader, pesHeader + sizeof(pesHeader), packet.begin() + pos);
+      EncodePts(pts, packet.data() + pos + 9);
+      pos += 14;
+    }
+    while (pos < 188 && esPos < es.size())
+      packet[pos++] = es[esPos++];
+    for (size_t i = 188; i < packetSize; ++i)
+      packet[i] = extra.empty() ? 0 : extra[(i - 188) % extra.size()];
+
+    data.insert(data.end(), packet.begin(), packet.end());
+    isFirst = false;
+  }
+}
+
+void AppendPacket(std::vector<uint8_t>& data, size_t packetSize, uint16_t pid)
+{
+  std::vector<uint8_t> packet(packetSize, 0);
+  packet[0] = 0x47;
+  packet[1] = static_cast<uint8_t>(pid >> 8);
+  packet[2] = static_cast<uint8_t>(pid);
+  packet[3] = 0x10;
+  data.insert(data.end(), packet.begin(), packet.end());
+}
+
+void Append(std::vector<uint8_t>& es, std::initializer_list<uint8_t> bytes, size_t fill = 0)
+{
+  es.insert(es.end(), bytes);
+  es.insert(es.end(), fill, 0x80);
+}
+
+bool AddPackets(SeekIndex& index, const std::vector<uint8_t>& data, size_t packetSize)
+{
+  for (size_t pos = 0; pos + packetSize <= data.size(); pos += packetSize)
+  {
+    if (!index.AddPacket(pos, data.data() + pos, packetSize))
+      return false;
+  }
+  return true;
+}
+
+// AUD and a SEI filling more than the first packet of the PES, as the encoders can do
+std::vector<uint8_t> H264Prefix()
+{
+  std::vector<uint8_t> es;
+  Append(es, {0, 0, 0, 1, 0x09, 0xF0});
+  Append(es, {0, 0, 1, 0x06}, 300);
+  return es;
+}
+} // namespace
+
+class SeekIndexTest : public ::testing::Test
+{
+};
+
+TEST_F(SeekIndexTest, DecodePts)
+{
+  const uint64_t values[] = {0, 1, 90000, 0x12345678, 0x100000000, 0x1FFFFFFFF};
+  for (uint64_t pts : values)
+  {
+    uint8_t data[5];
+    EncodePts(pts, data);
+    EXPECT_EQ(DecodePts(data), pts);
+  }
+}
+
+TEST_F(SeekIndexTest, H264RandomAccessAfterFirstPacket)
+{
+  std::vector<uint8_t> idr = H264Prefix();
+  Append(idr, {0, 0, 1, 0x65}, 100);
+  std::vector<uint8_t> slice = H264Prefix();
+  Append(slice, {0, 0, 1, 0x41}, 100);
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, slice);
+  AppendPacket(data, 188, OTHER_PID);
+  const size_t idrPos = data.size();
+  AppendPes(data, 188, VIDEO_PID, 4000, idr);
+  AppendPes(data, 188, VIDEO_PID, 7000, slice);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+  index.Finish();
+
+  const std::vector<SEEK_POINT>& points = index.GetPoints();
+  ASSERT_EQ(points.size(), 3);
+  EXPECT_EQ(index.GetCompletedCount(), 3);
+  EXPECT_EQ(index.GetRecoveryPointCount(), 1);
+  EXPECT_EQ(points[0].pts, 1000);
+  EXPECT_FALSE(points[0].is_recovery_point);
+  EXPECT_EQ(points[1].pos, idrPos);
+  EXPECT_EQ(points[1].pts, 4000);
+  EXPECT_TRUE(points[1].is_recovery_point);
+  EXPECT_FALSE(points[2].is_recovery_point);
+}
+
+TEST_F(SeekIndexTest, RandomAccessIndicator)
+{
+  std::vector<uint8_t> slice;
+  Append(slice, {0, 0, 1, 0x41}, 100);
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, slice, true);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+
+  ASSERT_EQ(index.GetCompletedCount(), 1);
+  EXPECT_TRUE(index.GetPoints()[0].is_recovery_point);
+}
+
+TEST_F(SeekIndexTest, StartCodeSplitBetweenPackets)
+{
+  // The first packet has 170 bytes of PES payload after the PES header
+  for (size_t split = 1; split <= 3; ++split)
+  {
+    std::vector<uint8_t> idr;
+    Append(idr, {0, 0, 0, 1, 0x09, 0xF0});
+    Append(idr, {0, 0, 1, 0x06}, 170 - split - 10);
+    Append(idr, {0, 0, 1, 0x65}, 100);
+    ASSERT_EQ(idr[170 - split], 0);
+
+    std::vector<uint8_t> data;
+    AppendPes(data, 188, VIDEO_PID, 1000, idr);
+
+    SeekIndex index;
+    index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+    EXPECT_TRUE(index.AddPacket(0, data.data(), 188));
+    EXPECT_EQ(index.GetCompletedCount(), 0);
+    EXPECT_TRUE(index.AddPacket(188, data.data() + 188, 188));
+
+    ASSERT_EQ(index.GetCompletedCount(), 1) << "split " << split;
+    EXPECT_TRUE(index.GetPoints()[0].is_recovery_point) << "split " << split;
+  }
+}
+
+TEST_F(SeekIndexTest, HevcRandomAccess)
+{
+  std::vector<uint8_t> cra;
+  Append(cra, {0, 0, 0, 1, 0x46, 0x01, 0x50});
+  Append(cra, {0, 0, 1, 0x4E, 0x01}, 200);
+  Append(cra, {0, 0, 1, 0x2A, 0x01}, 100);
+  std::vector<uint8_t> trail;
+  Append(trail, {0, 0, 0, 1, 0x46, 0x01, 0x50});
+  Append(trail, {0, 0, 1, 0x02, 0x01}, 100);
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, cra);
+  AppendPes(data, 188, VIDEO_PID, 4000, trail);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_HEVC);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+  index.Finish();
+
+  ASSERT_EQ(index.GetPoints().size(), 2);
+  EXPECT_TRUE(index.GetPoints()[0].is_recovery_point);
+  EXPECT_FALSE(index.GetPoints()[1].is_recovery_point);
+}
+
+TEST_F(SeekIndexTest, Mpeg2RandomAccess)
+{
+  std::vector<uint8_t> gop;
+  Append(gop, {0, 0, 1, 0xB2}, 20);
+  Append(gop, {0, 0, 1, 0xB8}, 4);
+  Append(gop, {0, 0, 1, 0x00}, 100);
+  std::vector<uint8_t> picture;
+  Append(picture, {0, 0, 1, 0x00}, 100);
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, gop);
+  AppendPes(data, 188, VIDEO_PID, 4000, picture);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_MPEG2);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+  index.Finish();
+
+  ASSERT_EQ(index.GetPoints().size(), 2);
+  EXPECT_TRUE(index.GetPoints()[0].is_recovery_point);
+  EXPECT_FALSE(index.GetPoints()[1].is_recovery_point);
+}
+
+TEST_F(SeekIndexTest, PacketSizes)
+{
+  // The bytes after the TS packet are not part of the payload, even with a start code
+  const std::vector<uint8_t> extra = {0, 0, 1, 0x65};
+  std::vector<uint8_t> slice = H264Prefix();
+  Append(slice, {0, 0, 1, 0x41}, 100);
+  std::vector<uint8_t> idr = H264Prefix();
+  Append(idr, {0, 0, 1, 0x65}, 100);
+
+  for (size_t packetSize : {188, 192, 204})
+  {
+    std::vector<uint8_t> data;
+    AppendPes(data, packetSize, VIDEO_PID, 1000, slice, false, extra);
+    const size_t idrPos = data.size();
+    AppendPes(data, packetSize, VIDEO_PID, 4000, idr, false, extra);
+
+    SeekIndex index;
+    index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+    EXPECT_TRUE(AddPackets(index, data, packetSize));
+    index.Finish();
+
+    const std::vector<SEEK_POINT>& points = index.GetPoints();
+    ASSERT_EQ(points.size(), 2) << "packet size " << packetSize;
+    EXPECT_FALSE(points[0].is_recovery_point) << "packet size " << packetSize;
+    EXPECT_EQ(points[1].pos, idrPos) << "packet size " << packetSize;
+    EXPECT_EQ(points[1].pts, 4000) << "packet size " << packetSize;
+    EXPECT_TRUE(points[1].is_recovery_point) << "packet size " << packetSize;
+  }
+}
+
+TEST_F(SeekIndexTest, CompletedOnNextPes)
+{
+  // The PES has no slice, only the next PES start completes it
+  std::vector<uint8_t> aud;
+  Append(aud, {0, 0, 0, 1, 0x09, 0xF0});
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, aud);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+  EXPECT_EQ(index.GetPoints().size(), 1);
+  EXPECT_EQ(index.GetCompletedCount(), 0);
+
+  AppendPes(data, 188, VIDEO_PID, 4000, aud);
+  EXPECT_TRUE(index.AddPacket(188, data.data() + 188, 188));
+  EXPECT_EQ(index.GetPoints().size(), 2);
+  EXPECT_EQ(index.GetCompletedCount(), 1);
+
+  index.Finish();
+  EXPECT_EQ(index.GetCompletedCount(), 2);
+  EXPECT_EQ(index.GetRecoveryPointCount(), 0);
+}
+
+TEST_F(SeekIndexTest, AudioPoints)
+{
+  std::vector<uint8_t> frame;
+  Append(frame, {0xFF, 0xF1}, 200);
+
+  std::vector<uint8_t> data;
+  AppendPes(data, 188, VIDEO_PID, 1000, frame);
+  AppendPes(data, 188, VIDEO_PID, 2920, frame);
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_AUDIO_AAC);
+  EXPECT_TRUE(AddPackets(index, data, 188));
+
+  // Each PES start is a seek point, without waiting for its next packets
+  ASSERT_EQ(index.GetCompletedCount(), 2);
+  EXPECT_EQ(index.GetPoints()[1].pts, 2920);
+}
+
+TEST_F(SeekIndexTest, SyncLost)
+{
+  std::vector<uint8_t> data;
+  AppendPacket(data, 188, VIDEO_PID);
+  data[0] = 0;
+
+  SeekIndex index;
+  index.Reset(VIDEO_PID, STREAM_TYPE_VIDEO_H264);
+  EXPECT_FALSE(index.AddPacket(0, data.data(), 188));
+  EXPECT_EQ(index.GetPoints().size(), 0);
+}
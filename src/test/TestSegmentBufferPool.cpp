@@ -0,0 +1,169 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/SegmentBufferPool.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace adaptive;
+
+class SegmentBufferPoolTest : public ::testing::Test
+{
+};
+
+TEST_F(SegmentBufferPoolTest, ClassSizes)
+{
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(1), 64 * 1024);
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(64 * 1024), 64 * 1024);
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(64 * 1024 + 1), 96 * 1024);
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(3000000), 3 * 1024 * 1024);
+  // Over the biggest size class the block size is doubled
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(32 * 1024 * 1024 + 1), 64 * 1024 * 1024);
+  EXPECT_EQ(CSegmentBufferPool::GetClassSize(100000000), 128 * 1024 * 1024);
+}
+
+TEST_F(SegmentBufferPoolTest, ReuseReleasedBlock)
+{
+  CSegmentBufferPool pool(64 * 1024 * 1024);
+  std::vector<uint8_t> buffer;
+
+  pool.Acquire(buffer, 500000);
+  EXPECT_GE(buffer.capacity(), 512 * 1024);
+  const uint8_t* data = buffer.data();
+
+  pool.Release(buffer);
+  EXPECT_EQ(buffer.capacity(), 0);
+
+  // A segment of similar size from another stream get the same block
+  std::vector<uint8_t> otherBuffer;
+  pool.Acquire(otherBuffer, 400000);
+  EXPECT_EQ(otherBuffer.data(), data);
+
+  const CSegmentBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.m_allocations, 1);
+  EXPECT_EQ(stats.m_reuses, 1);
+  EXPECT_EQ(stats.m_cachedBytes, 0);
+}
+
+TEST_F(SegmentBufferPoolTest, GrowPreserveData)
+{
+  CSegmentBufferPool pool(64 * 1024 * 1024);
+  std::vector<uint8_t> buffer;
+
+  pool.Acquire(buffer, 1000);
+  buffer.assign({1, 2, 3, 4});
+  pool.Acquire(buffer, 200000);
+
+  EXPECT_GE(buffer.capacity(), 200000);
+  EXPECT_EQ(buffer, std::vector<uint8_t>({1, 2, 3, 4}));
+  // The previous block is cached for the reuse
+  EXPECT_EQ(pool.GetStats().m_cachedBytes, 64 * 1024);
+}
+
+TEST_F(SegmentBufferPoolTest, LimitAndTrim)
+{
+  CSegmentBufferPool pool(1024 * 1024);
+  std::vector<uint8_t> buffer1;
+  std::vector<uint8_t> buffer2;
+  pool.Acquire(buffer1, 768 * 1024);
+  pool.Acquire(buffer2, 512 * 1024);
+
+  // In use plus cached memory would exceed the limit, so the block is freed
+  pool.Release(buffer1);
+  EXPECT_EQ(pool.GetStats().m_cachedBytes, 0);
+
+  pool.Release(buffer2);
+  CSegmentBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.m_inUseBytes, 0);
+  EXPECT_EQ(stats.m_cachedBytes, 512 * 1024);
+  EXPECT_EQ(stats.m_peakInUseBytes, 1280 * 1024);
+
+  pool.Trim();
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.m_cachedBytes, 0);
+  EXPECT_EQ(stats.m_peakTotalBytes, 1280 * 1024);
+}
+
+TEST_F(SegmentBufferPoolTest, ChunkedGrowth)
+{
+  CSegmentBufferPool pool(512 * 1024 * 1024);
+  std::vector<uint8_t> buffer;
+
+  // A segment of unknown size read by chunks of 32 KiB, up to 200 MiB
+  constexpr size_t chunkSize = 32 * 1024;
+  for (size_t size = chunkSize; size <= 200 * 1024 * 1024; size += chunkSize)
+  {
+    pool.Acquire(buffer, size);
+    buffer.resize(size);
+  }
+
+  // Each size class up to 32 MiB, then 64, 128, 256 MiB
+  const CSegmentBufferPool::Stats stats = pool.GetStats();
+  EXPECT_LE(stats.m_allocations, 24);
+  EXPECT_EQ(buffer.capacity(), 256 * 1024 * 1024);
+  EXPECT_EQ(stats.m_inUseBytes, buffer.capacity());
+
+  pool.Release(buffer);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 0);
+}
+
+TEST_F(SegmentBufferPoolTest, GrowOutsidePool)
+{
+  CSegmentBufferPool pool(64 * 1024 * 1024);
+  std::vector<uint8_t> buffer1;
+  std::vector<uint8_t> buffer2;
+
+  pool.Acquire(buffer1, 1000);
+  pool.Acquire(buffer2, 1000);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 128 * 1024);
+
+  // The buffer is reallocated without the pool, e.g. by the tree processing the data
+  buffer1.resize(100 * 1024);
+  buffer1.insert(buffer1.end(), 200 * 1024, 0);
+  const uint64_t grownCapacity = buffer1.capacity();
+
+  // The growth is accounted when the pool see the buffer again
+  pool.Acquire(buffer1, 1000);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, grownCapacity + 64 * 1024);
+
+  pool.Release(buffer1);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 64 * 1024);
+  pool.Release(buffer2);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 0);
+
+  // A buffer never acquired from the pool is accounted only while released
+  std::vector<uint8_t> buffer3(300000);
+  pool.Release(buffer3);
+  const CSegmentBufferPool::Stats stats = pool.GetStats();
+  EXPECT_EQ(stats.m_inUseBytes, 0);
+  EXPECT_EQ(stats.m_peakInUseBytes, grownCapacity + 64 * 1024);
+}
+
+TEST_F(SegmentBufferPoolTest, TransferStorage)
+{
+  CSegmentBufferPool pool(64 * 1024 * 1024);
+  std::vector<uint8_t> buffer;
+  std::vector<uint8_t> detached;
+
+  pool.Acquire(buffer, 100000);
+  buffer.assign({1, 2, 3});
+  const uint8_t* data = buffer.data();
+
+  pool.Transfer(buffer, detached);
+  EXPECT_EQ(buffer.capacity(), 0);
+  EXPECT_EQ(detached.data(), data);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 128 * 1024);
+
+  pool.Release(buffer);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 128 * 1024);
+  pool.Release(detached);
+  EXPECT_EQ(pool.GetStats().m_inUseBytes, 0);
+  EXPECT_EQ(pool.GetStats().m_cachedBytes, 128 * 1024);
+}
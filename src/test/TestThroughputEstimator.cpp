@@ -0,0 +1,213 @@
+/*
+ *  Copyright (C) 2023 Team Kodi
+ *  This file is part of Kodi - https://kodi.tv
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSES/README.md for more information.
+ */
+
+#include "../common/ThroughputEstimator.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+using namespace CHOOSER;
+
+namespace
+{
+struct TraceSample
+{
+  size_t bytes;
+  double seconds;
+};
+
+// Transfer samples of 100ms at 5 MB/s, with a chunk served from a cache
+const std::vector<TraceSample> TRACE_CACHE_PEAK = {
+    {500000, 0.1}, {500000, 0.1}, {500000, 0.1}, {500000, 0.1},  {500000, 0.1},
+    {500000, 0.1}, {500000, 0.1}, {500000, 0.1}, {5000000, 0.1}, {500000, 0.1}};
+
+// Transfer samples of 500ms at 4 MB/s, then the bandwidth collapse to 0.5 MB/s
+const std::vector<TraceSample> TRACE_COLLAPSE = {
+    {2000000, 0.5}, {2000000, 0.5}, {2000000, 0.5}, {2000000, 0.5}, {2000000, 0.5},
+    {2000000, 0.5}, {250000, 0.5},  {250000, 0.5},  {250000, 0.5},  {250000, 0.5},
+    {250000, 0.5},  {250000, 0.5}};
+
+void Replay(IThroughputEstimator& estimator, const std::vector<TraceSample>& trace)
+{
+  for (const TraceSample& sample : trace)
+    estimator.AddSample(sample.bytes, sample.seconds);
+}
+
+// A transfer reading a chunk each tick of 10ms, from the tick after the start to the end tick
+struct TraceTransfer
+{
+  int startTick;
+  int endTick;
+  size_t bytesPerTick;
+};
+
+void ReplayTransfers(CTransferAggregator& aggregator, const std::vector<TraceTransfer>& trace)
+{
+  int lastTick{0};
+  for (const TraceTransfer& transfer : trace)
+    lastTick = std::max(lastTick, transfer.endTick);
+
+  for (int tick = 0; tick <= lastTick; ++tick)
+  {
+    const double time = tick * 0.01;
+    for (const TraceTransfer& transfer : trace)
+    {
+      if (tick == transfer.startTick)
+        aggregator.StartTransfer(time);
+      else if (tick > transfer.startTick && tick <= transfer.endTick)
+      {
+        aggregator.AddData(transfer.bytesPerTick, time);
+        if (tick == transfer.endTick)
+          aggregator.EndTransfer(time);
+      }
+    }
+  }
+}
+} // unnamed namespace
+
+class ThroughputEstimatorTest : public ::testing::Test
+{
+};
+
+TEST_F(ThroughputEstimatorTest, NoSamples)
+{
+  CThroughputHarmonicMean harmonic(20);
+  CThroughputDualEwma ewma(3.0, 8.0);
+
+  EXPECT_FALSE(harmonic.HasSamples());
+  EXPECT_FALSE(ewma.HasSamples());
+  EXPECT_EQ(harmonic.GetThroughput(), 0);
+  EXPECT_EQ(ewma.GetThroughput(), 0);
+}
+
+TEST_F(ThroughputEstimatorTest, ConstantRate)
+{
+  const std::vector<TraceSample> trace(10, {300000, 0.1});
+  CThroughputHarmonicMean harmonic(20);
+  CThroughputDualEwma ewma(3.0, 8.0);
+  Replay(harmonic, trace);
+  Replay(ewma, trace);
+
+  EXPECT_NEAR(harmonic.GetThroughput(), 3000000, 1);
+  // The zero bias correction allow to get the right rate also with few samples
+  EXPECT_NEAR(ewma.GetThroughput(), 3000000, 1);
+}
+
+TEST_F(ThroughputEstimatorTest, IgnoreTooShortSamples)
+{
+  CThroughputHarmonicMean harmonic(20);
+  harmonic.AddSample(32768, 0.0001);
+  harmonic.AddSample(0, 0.5);
+  EXPECT_FALSE(harmonic.HasSamples());
+
+  harmonic.AddSample(100000, 0.1);
+  EXPECT_NEAR(harmonic.GetThroughput(), 1000000, 1);
+}
+
+TEST_F(ThroughputEstimatorTest, TimeToFirstByteSeparatedFromRate)
+{
+  CThroughputDualEwma ewma(3.0, 8.0);
+  ewma.AddTimeToFirstByte(0.5);
+  EXPECT_FALSE(ewma.HasSamples());
+
+  Replay(ewma, std::vector<TraceSample>(5, {100000, 0.1}));
+  ewma.AddTimeToFirstByte(1.0);
+
+  EXPECT_NEAR(ewma.GetThroughput(), 1000000, 1);
+  EXPECT_NEAR(ewma.GetTimeToFirstByte(), 0.6, 0.0001);
+}
+
+TEST_F(ThroughputEstimatorTest, HarmonicMeanReplayCachePeak)
+{
+  CThroughputHarmonicMean harmonic(20);
+  Replay(harmonic, TRACE_CACHE_PEAK);
+
+  // The arithmetic mean would be 9.5 MB/s
+  EXPECT_NEAR(harmonic.GetThroughput(), 5494505.49, 1);
+}
+
+TEST_F(ThroughputEstimatorTest, HarmonicMeanSlidingWindow)
+{
+  CThroughputHarmonicMean harmonic(4);
+  Replay(harmonic, TRACE_COLLAPSE);
+
+  // Only the last 4 samples at 0.5 MB/s are in the window
+  EXPECT_NEAR(harmonic.GetThroughput(), 500000, 1);
+}
+
+TEST_F(ThroughputEstimatorTest, DualEwmaReplayCollapse)
+{
+  CThroughputDualEwma ewma(3.0, 8.0);
+  Replay(ewma, TRACE_COLLAPSE);
+
+  // After 3 secs at 0.5 MB/s the fast average is the lowest one
+  EXPECT_NEAR(ewma.GetThroughput(), 1666666.67, 1);
+  EXPECT_LT(ewma.GetThroughput(), 2000000);
+}
+
+TEST_F(ThroughputEstimatorTest, DualEwmaRecoverSlowly)
+{
+  CThroughputDualEwma ewma(3.0, 8.0);
+  Replay(ewma, std::vector<TraceSample>(20, {50000, 0.5}));
+  Replay(ewma, std::vector<TraceSample>(6, {500000, 0.5}));
+
+  // After 3 secs at 1 MB/s the slow average hold back the estimation
+  EXPECT_NEAR(ewma.GetThroughput(), 404835.96, 1);
+}
+
+TEST_F(ThroughputEstimatorTest, CreateByType)
+{
+  auto harmonic = CreateThroughputEstimator("harmonic-mean");
+  auto fallback = CreateThroughputEstimator("");
+  EXPECT_NE(dynamic_cast<CThroughputHarmonicMean*>(harmonic.get()), nullptr);
+  EXPECT_NE(dynamic_cast<CThroughputDualEwma*>(fallback.get()), nullptr);
+}
+
+TEST_F(ThroughputEstimatorTest, AggregateOverlappingTransfers)
+{
+  // Three concurrent transfers at 2 MB/s for 2 secs
+  const std::vector<TraceTransfer> trace(3, {0, 200, 20000});
+
+  // The rate of each transfer underestimate the throughput
+  CThroughputHarmonicMean perTransfer(100);
+  for (const TraceTransfer& transfer : trace)
+  {
+    CTransferAggregator aggregator(perTransfer, 0.1);
+    ReplayTransfers(aggregator, {transfer});
+  }
+  EXPECT_NEAR(perTransfer.GetThroughput(), 2000000, 1);
+
+  CThroughputHarmonicMean harmonic(100);
+  CTransferAggregator aggregator(harmonic, 0.1);
+  ReplayTransfers(aggregator, trace);
+  EXPECT_EQ(aggregator.GetActiveTransfers(), 0);
+  EXPECT_NEAR(harmonic.GetThroughput(), 6000000, 60000);
+}
+
+TEST_F(ThroughputEstimatorTest, AggregateStaggeredTransfers)
+{
+  // A transfer at 2 MB/s overlapped for half of its time by another one
+  CThroughputHarmonicMean harmonic(100);
+  CTransferAggregator aggregator(harmonic, 0.1);
+  ReplayTransfers(aggregator, {{0, 100, 20000}, {50, 150, 20000}});
+
+  // Samples of 0.5 secs at 2 MB/s, 0.5 secs at 4 MB/s, 0.5 secs at 2 MB/s
+  EXPECT_NEAR(harmonic.GetThroughput(), 2400000, 24000);
+}
+
+TEST_F(ThroughputEstimatorTest, AggregateIgnoreIdleTime)
+{
+  // Two transfers at 4 MB/s, with 2 secs of idle time between them
+  CThroughputHarmonicMean harmonic(100);
+  CTransferAggregator aggregator(harmonic, 0.1);
+  ReplayTransfers(aggregator, {{0, 100, 40000}, {300, 400, 40000}});
+
+  EXPECT_NEAR(harmonic.GetThroughput(), 4000000, 1);
+}
@@ -10,6 +10,7 @@
 
 #include "../common/AdaptiveTreeFactory.h"
 #include "../common/SegTemplate.h"
+#include "../common/Segment.h"
 #include "../utils/UrlUtils.h"
 
 #include <gtest/gtest.h>
@@ -256,3 +257,46 @@ TEST_F(UtilsTest, SegTemplateFormatUrlChecks)
   ret = segTpl.FormatUrl(url, "repID", 1500, 1, 0);
   EXPECT_EQ(ret, "https://cdn.com/_$_example/$Bandwidth");
 }
+
+TEST_F(UtilsTest, SpinCachePartitionPointOnRotatedTimeline)
+{
+  static const size_t segmentsCount{100000};
+  static const uint64_t segmentDuration{1000};
+
+  CSpinCache<CSegment> timeline;
+  timeline.GetData().reserve(segmentsCount);
+  for (size_t i = 0; i < segmentsCount; ++i)
+  {
+    CSegment seg;
+    seg.startPTS_ = i * segmentDuration;
+    timeline.GetData().emplace_back(seg);
+  }
+
+  // Live updates replace the oldest segments, so the base position is rotated
+  for (size_t i = 0; i < 1234; ++i)
+  {
+    CSegment seg;
+    seg.startPTS_ = (segmentsCount + i) * segmentDuration;
+    timeline.Insert(seg);
+  }
+
+  auto linearSearch = [&timeline](uint64_t pts)
+  {
+    size_t pos{0};
+    while (pos < timeline.GetSize() && timeline.Get(pos)->startPTS_ < pts)
+      ++pos;
+    return pos;
+  };
+
+  const uint64_t firstPts = timeline.Get(0)->startPTS_;
+  const uint64_t lastPts = timeline.Get(segmentsCount - 1)->startPTS_;
+
+  for (uint64_t pts : {uint64_t{0}, firstPts, firstPts + 1, firstPts + 500 * segmentDuration,
+                       (segmentsCount - 1) * segmentDuration,
+                       (segmentsCount - 1) * segmentDuration + 1, lastPts, lastPts + 1})
+  {
+    const size_t pos = timeline.PartitionPoint([pts](const CSegment& segment)
+                                               { return segment.startPTS_ < pts; });
+    EXPECT_EQ(pos, linearSearch(pts));
+  }
+}
@@ -107,6 +107,12 @@ double UTILS::CURL::CUrl::GetDownloadSpeed()
   return m_file.GetFileDownloadSpeed();
 }
 
+uint64_t UTILS::CURL::CUrl::GetContentLength()
+{
+  return STRING::ToUint64(
+      m_file.GetPropertyValue(ADDON_FILE_PROPERTY_RESPONSE_HEADER, "Content-Length"));
+}
+
 bool UTILS::CURL::CUrl::IsChunked()
 {
   std::string transferEncodingStr{
@@ -93,6 +93,13 @@ public:
   */
   size_t GetTotalByteRead() { return m_bytesRead; }
 
+ /*!
+  * \brief Get the content length from the HTTP response header.
+  *        Note: if the content is compressed (e.g. gzip) the value refers to the compressed data.
+  * \return The content length in bytes, otherwise 0 if not available
+  */
+  uint64_t GetContentLength();
+
  /*!
   * \brief Determines if the data to download is in chunks.
   */